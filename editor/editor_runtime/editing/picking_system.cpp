@@ -10,6 +10,7 @@
 #include <runtime/ecs/components/camera_component.h>
 #include <runtime/ecs/components/model_component.h>
 #include <runtime/ecs/components/transform_component.h>
+#include <runtime/ecs/systems/bounds_system.h>
 #include <runtime/input/input.h>
 #include <runtime/rendering/camera.h>
 #include <runtime/rendering/material.h>
@@ -81,35 +82,36 @@ void picking_system::frame_render(delta_t dt)
 		pass.set_view_proj(pick_view, pick_proj);
 		pass.bind(surface_.get());
 
-		ecs.for_each<transform_component, model_component>(
-			[this, &pass, &pick_frustum](runtime::entity e, transform_component& transform_comp_ref,
-										 model_component& model_comp_ref) {
-				auto& model = model_comp_ref.get_model();
-				if(!model.is_valid())
-					return;
+		// Only the meshes whose cached world bounds are inside the frustum
+		auto& bounds = core::get_subsystem<runtime::bounds_system>();
+		bounds.update();
 
-				const auto& world_transform = transform_comp_ref.get_transform();
+		std::vector<std::size_t> visible;
+		bounds.query(pick_frustum, [&visible](std::size_t i) { visible.push_back(i); });
 
-				auto mesh = model.get_lod(0);
-				if(!mesh)
-					return;
+		for(const auto i : visible)
+		{
+			auto transform_comp_ptr = bounds.get_transforms()[i].lock();
+			auto model_comp_ptr = bounds.get_models()[i].lock();
+			if(!transform_comp_ptr || !model_comp_ptr)
+				continue;
 
-				const auto& bounds = mesh->get_bounds();
+			auto& model = model_comp_ptr->get_model();
+			if(!model.is_valid())
+				continue;
 
-				// Test the bounding box of the mesh
-				if(!math::frustum::test_obb(pick_frustum, bounds, world_transform))
-					return;
+			const auto& world_transform = transform_comp_ptr->get_transform();
 
-				auto entity_index = e.id().index();
-				std::uint32_t rr = (entity_index)&0xff;
-				std::uint32_t gg = (entity_index >> 8) & 0xff;
-				std::uint32_t bb = (entity_index >> 16) & 0xff;
-				math::vec4 color_id = {rr / 255.0f, gg / 255.0f, bb / 255.0f, 1.0f};
+			auto entity_index = bounds.get_entities()[i].id().index();
+			std::uint32_t rr = (entity_index)&0xff;
+			std::uint32_t gg = (entity_index >> 8) & 0xff;
+			std::uint32_t bb = (entity_index >> 16) & 0xff;
+			math::vec4 color_id = {rr / 255.0f, gg / 255.0f, bb / 255.0f, 1.0f};
 
-				const auto& bone_transforms = model_comp_ref.get_bone_transforms();
-				model.render(pass.id, world_transform, bone_transforms, true, true, true, 0, 0,
-							 program_.get(), [&color_id](auto& p) { p.set_uniform("u_id", &color_id); });
-			});
+			const auto& bone_transforms = model_comp_ptr->get_bone_transforms();
+			model.render(pass.id, world_transform, bone_transforms, true, true, true, 0, 0, program_.get(),
+						 [&color_id](auto& p) { p.set_uniform("u_id", &color_id); });
+		}
 	}
 
 	// If the user previously clicked, and we're done reading data from GPU, look at ID buffer on CPU
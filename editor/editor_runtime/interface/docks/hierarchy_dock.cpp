@@ -566,7 +566,8 @@ void hierarchy_dock::render(const ImVec2& /*unused*/)
 	auto& sg = core::get_subsystem<runtime::scene_graph>();
 	auto& input = core::get_subsystem<runtime::input>();
 
-	auto& roots = sg.get_roots();
+	// copy, the context menus can create and reparent entities while drawing
+	auto roots = sg.get_roots();
 	auto& editor_camera = es.camera;
 	auto& selected = es.selection_data.object;
 
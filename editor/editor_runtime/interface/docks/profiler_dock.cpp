@@ -0,0 +1,154 @@
+#include "profiler_dock.h"
+
+#include <core/filesystem/filesystem.h>
+#include <core/logging/logging.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace
+{
+double to_ms(std::int64_t ns)
+{
+	return double(ns) / 1000000.0;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : draw_zones ()
+/// <summary>
+/// Draws the zones of one thread as a tree. 'zones' are sorted by begin, so
+/// every zone comes right after its parent and before its later siblings.
+/// </summary>
+//-----------------------------------------------------------------------------
+void draw_zones(const std::vector<core::profiler::record>& zones)
+{
+	// depths of the open tree nodes
+	std::vector<std::uint32_t> open;
+	auto collapsed = std::numeric_limits<std::uint32_t>::max();
+
+	for(std::size_t i = 0; i < zones.size(); ++i)
+	{
+		const auto& zone = zones[i];
+		if(collapsed != std::numeric_limits<std::uint32_t>::max())
+		{
+			if(zone.depth > collapsed)
+			{
+				continue;
+			}
+			collapsed = std::numeric_limits<std::uint32_t>::max();
+		}
+
+		while(!open.empty() && open.back() >= zone.depth)
+		{
+			gui::TreePop();
+			open.pop_back();
+		}
+
+		const bool has_children = i + 1 < zones.size() && zones[i + 1].depth > zone.depth;
+		const ImGuiTreeNodeFlags flags = has_children ? 0 : ImGuiTreeNodeFlags_Leaf;
+		if(gui::TreeNodeEx(&zone, flags, "%s  %0.3f [ms]", zone.name, to_ms(zone.end - zone.begin)))
+		{
+			open.push_back(zone.depth);
+		}
+		else
+		{
+			collapsed = zone.depth;
+		}
+	}
+
+	for(std::size_t i = 0; i < open.size(); ++i)
+	{
+		gui::TreePop();
+	}
+}
+} // namespace
+
+profiler_dock::profiler_dock(const std::string& dtitle, bool close_button, const ImVec2& min_size)
+{
+	initialize(dtitle, close_button, min_size, std::bind(&profiler_dock::render, this, std::placeholders::_1));
+}
+
+void profiler_dock::render(const ImVec2&)
+{
+	namespace profiler = core::profiler;
+
+	bool enabled = profiler::is_enabled();
+	if(gui::Checkbox("ENABLED", &enabled))
+	{
+		profiler::set_enabled(enabled);
+	}
+	gui::SameLine();
+	gui::Checkbox("PAUSE", &paused_);
+	gui::SameLine();
+	if(gui::Button("SAVE TRACE"))
+	{
+		// Everything still in the buffers, usually a few frames.
+		const auto path = fs::resolve_protocol("app:/profiler_trace.json").string();
+		if(profiler::save_chrome_trace(profiler::collect(), path))
+		{
+			APPLOG_INFO("Saved profiler trace to {0}", path);
+		}
+		else
+		{
+			APPLOG_ERROR("Failed to save profiler trace to {0}", path);
+		}
+	}
+	gui::Separator();
+
+	if(!paused_)
+	{
+		frame_ = profiler::get_last_frame();
+		capture_ = profiler::collect(frame_.begin);
+	}
+
+	gui::Text("Frame: %0.3f [ms]", to_ms(frame_.end - frame_.begin));
+
+	// latest value of each counter
+	std::map<std::string, double> counters;
+	std::vector<profiler::record> zones;
+	for(const auto& thread : capture_.threads)
+	{
+		zones.clear();
+		for(const auto& r : thread.records)
+		{
+			if(r.begin < frame_.begin || r.begin >= frame_.end)
+			{
+				continue;
+			}
+
+			if(r.kind == profiler::record_kind::zone)
+			{
+				zones.emplace_back(r);
+			}
+			else if(r.kind == profiler::record_kind::counter)
+			{
+				counters[r.name] = r.value;
+			}
+		}
+
+		if(zones.empty())
+		{
+			continue;
+		}
+
+		std::sort(std::begin(zones), std::end(zones), [](const auto& lhs, const auto& rhs) {
+			return lhs.begin < rhs.begin || (lhs.begin == rhs.begin && lhs.depth < rhs.depth);
+		});
+
+		gui::PushID(int(thread.id));
+		if(gui::CollapsingHeader(thread.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			draw_zones(zones);
+		}
+		gui::PopID();
+	}
+
+	if(!counters.empty() && gui::CollapsingHeader("COUNTERS", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for(const auto& counter : counters)
+		{
+			gui::Text("%-24s %g", counter.first.c_str(), counter.second);
+		}
+	}
+}
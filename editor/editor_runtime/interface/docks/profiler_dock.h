@@ -0,0 +1,18 @@
+#pragma once
+
+#include "imguidock.h"
+
+#include <core/profiler/profiler.h>
+
+struct profiler_dock : public imguidock::dock
+{
+	profiler_dock(const std::string& dtitle, bool close_button, const ImVec2& min_size);
+
+	void render(const ImVec2& area);
+
+private:
+	/// the last complete frame, or the frozen one while paused
+	core::profiler::frame_span frame_;
+	core::profiler::capture capture_;
+	bool paused_ = false;
+};
@@ -802,7 +802,8 @@ void project_dock::import()
 			fs::path p = fs::path(path).make_preferred();
 			fs::path filename = p.filename();
 
-			auto task = ts.push_on_worker_thread(
+			auto task = ts.push_on_pool(
+				core::task_pool::io, core::task_priority::normal,
 				[opened = cache_.get_path()](const fs::path& path, const fs::path& filename) {
 					fs::error_code err;
 					fs::path dir = opened / filename;
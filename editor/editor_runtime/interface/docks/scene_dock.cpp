@@ -15,6 +15,8 @@
 #include <runtime/ecs/components/transform_component.h>
 #include <runtime/ecs/constructs/prefab.h>
 #include <runtime/ecs/constructs/utils.h>
+#include <runtime/ecs/systems/deferred_rendering.h>
+#include <runtime/ecs/systems/system_scheduler.h>
 #include <runtime/input/input.h>
 #include <runtime/rendering/camera.h>
 #include <runtime/rendering/mesh.h>
@@ -125,6 +127,25 @@ void scene_dock::show_statistics(const ImVec2& area, unsigned int fps, bool& sho
 			gui::Text("Total Draw Calls: %u", stats->numDraw);
 			gui::Text("UI Draw Calls: %u", ui_draw_calls);
 			gui::Text("Scene Draw Calls: %u", math::abs<std::uint32_t>(stats->numDraw - ui_draw_calls));
+
+			gui::Separator();
+
+			auto& renderer = core::get_subsystem<runtime::deferred_rendering>();
+			bool occlusion_culling = renderer.is_occlusion_culling();
+			if(gui::Checkbox("Occlusion culling", &occlusion_culling))
+			{
+				renderer.set_occlusion_culling(occlusion_culling);
+			}
+
+			const auto& es = core::get_subsystem<editor::editing_system>();
+			const auto& occlusion_stats = renderer.get_occlusion_stats();
+			auto it = occlusion_stats.find(es.camera);
+			if(it != occlusion_stats.end())
+			{
+				const auto& occlusion = it->second;
+				gui::Text("Occluded Draws: %u / %u (%.1f%%)", std::uint32_t(occlusion.occluded),
+						  std::uint32_t(occlusion.draws), double(occlusion.get_culled_percentage()));
+			}
 			gui::PopFont();
 		}
 		if(gui::CollapsingHeader(ICON_FA_PUZZLE_PIECE "\tResources"))
@@ -161,6 +182,24 @@ void scene_dock::show_statistics(const ImVec2& area, unsigned int fps, bool& sho
 			gui::PopFont();
 		}
 
+		if(gui::CollapsingHeader(ICON_FA_COGS "\tSystems"))
+		{
+			auto& scheduler = core::get_subsystem<runtime::system_scheduler>();
+			bool serial = scheduler.is_serial();
+			if(gui::Checkbox("Serial", &serial))
+			{
+				scheduler.set_serial(serial);
+			}
+
+			gui::PushFont("default");
+			for(const auto& timing : scheduler.get_timings())
+			{
+				const auto ms = std::chrono::duration<double, std::milli>(timing.time).count();
+				gui::Text("[%u] %-24s %0.3f [ms]", std::uint32_t(timing.stage), timing.name.c_str(), ms);
+			}
+			gui::PopFont();
+		}
+
 		if(gui::CollapsingHeader(ICON_FA_CLOCK_O "\tProfiler"))
 		{
             if(gui::Checkbox("Enable profiler", &enable_profiler))
@@ -7,6 +7,7 @@
 #include "../interface/docks/game_dock.h"
 #include "../interface/docks/hierarchy_dock.h"
 #include "../interface/docks/inspector_dock.h"
+#include "../interface/docks/profiler_dock.h"
 #include "../interface/docks/project_dock.h"
 #include "../interface/docks/scene_dock.h"
 #include "../interface/docks/style_dock.h"
@@ -354,6 +355,10 @@ void app::draw_menubar(render_window& window)
 			{
 				create_window_with_dock<style_dock>("STYLE");
 			}
+			if(gui::MenuItem("PROFILER"))
+			{
+				create_window_with_dock<profiler_dock>("PROFILER");
+			}
 			gui::EndMenu();
 		}
 		float offset = gui::GetWindowHeight();
@@ -439,6 +444,13 @@ void app::start(cmd_line::parser& parser)
 
 	runtime::app::start(parser);
 
+	// The docks need a window to live in.
+	if(headless_)
+	{
+		quit_with_error("The editor can not run headless.");
+		return;
+	}
+
 	core::add_subsystem<gui_system>();
 	core::add_subsystem<docking_system>();
 	core::add_subsystem<editing_system>();
@@ -465,6 +477,7 @@ void app::create_docks()
 	auto project = std::make_unique<project_dock>("PROJECT", true, ImVec2(200.0f, 200.0f));
 	auto console = std::make_unique<console_dock>("CONSOLE", true, ImVec2(200.0f, 200.0f), console_log_);
 	auto style = std::make_unique<style_dock>("STYLE", true, ImVec2(300.0f, 200.0f));
+	auto profiler = std::make_unique<profiler_dock>("PROFILER", true, ImVec2(300.0f, 200.0f));
 
 	auto& docking = core::get_subsystem<docking_system>();
 	auto& dockspace = docking.get_dockspace(main_window->get_id());
@@ -475,6 +488,7 @@ void app::create_docks()
 	dockspace.dock_to(console.get(), imguidock::slot::bottom, 300, true);
 	dockspace.dock_with(project.get(), console.get(), imguidock::slot::tab, 250, true);
 	dockspace.dock_with(style.get(), project.get(), imguidock::slot::right, 400, true);
+	dockspace.dock_with(profiler.get(), style.get(), imguidock::slot::tab, 400, false);
 
 	docking.register_dock(std::move(scene));
 	docking.register_dock(std::move(game));
@@ -483,6 +497,7 @@ void app::create_docks()
 	docking.register_dock(std::move(console));
 	docking.register_dock(std::move(project));
 	docking.register_dock(std::move(style));
+	docking.register_dock(std::move(profiler));
 }
 
 void app::register_console_commands()
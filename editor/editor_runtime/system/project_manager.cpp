@@ -77,8 +77,11 @@ static std::uint64_t watch_assets(const fs::path& dir, const std::string& wildca
 						using namespace runtime;
 						load_flags flags = is_initial_list ? load_flags::standard : load_flags::reload;
 
-						// created or modified
-						auto task = ts.push_on_worker_thread([flags, key, &am]() { am.load<T>(key, flags); });
+						// created or modified, reloads must not hold up the frames
+						const auto priority =
+							is_initial_list ? core::task_priority::normal : core::task_priority::background;
+						auto task = ts.push_on_pool(core::task_pool::compute, priority,
+													[flags, key, &am]() { am.load<T>(key, flags); });
 					}
 				}
 			}
@@ -92,7 +95,9 @@ static void add_to_syncer(std::vector<uint64_t>& watchers, fs::syncer& syncer, c
 {
 	auto& ts = core::get_subsystem<core::task_system>();
 	auto on_modified = [&ts](const auto& ref_path, const auto& synced_paths, bool is_initial_listing) {
-		auto task = ts.push_on_worker_thread(
+		// The compilers run as child processes.
+		auto task = ts.push_on_pool(
+			core::task_pool::io, core::task_priority::background,
 			[ref_path, synced_paths = remove_meta_tag(synced_paths), is_initial_listing]() {
 				fs::path output = synced_paths.front();
 				fs::error_code err;
@@ -120,7 +125,9 @@ void add_to_syncer<gfx::shader>(std::vector<uint64_t>& watchers, fs::syncer& syn
 	auto& ts = core::get_subsystem<core::task_system>();
 
 	auto on_modified = [&ts](const auto& ref_path, const auto& synced_paths, bool is_initial_listing) {
-		auto task = ts.push_on_worker_thread(
+		// The compilers run as child processes.
+		auto task = ts.push_on_pool(
+			core::task_pool::io, core::task_priority::background,
 			[ref_path, synced_paths = remove_meta_tag(synced_paths), is_initial_listing]() {
 				const auto& renderer_extension = gfx::get_renderer_filename_extension();
 				auto it = std::find_if(std::begin(synced_paths), std::end(synced_paths),
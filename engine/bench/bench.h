@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+// Microbenchmarks for the engine's hot paths. Each one prints the fastest of
+// several runs, which is the one least disturbed by the rest of the machine.
+// Build in release, the numbers of a debug build mean nothing.
+//-----------------------------------------------------------------------------
+namespace bench
+{
+//-----------------------------------------------------------------------------
+//  Name : measure ()
+/// <summary>
+/// Runs 'f' 'repeats' times and returns the fastest run in microseconds.
+/// </summary>
+//-----------------------------------------------------------------------------
+template<typename F>
+inline double measure(std::size_t repeats, F&& f)
+{
+	auto best = std::numeric_limits<double>::max();
+	for(std::size_t i = 0; i < repeats; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+	}
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : keep ()
+/// <summary>
+/// Stores a result where the optimizer cannot see it is never read.
+/// </summary>
+//-----------------------------------------------------------------------------
+template<typename T>
+inline void keep(T value)
+{
+	static volatile T sink;
+	sink = value;
+	static_cast<void>(sink);
+}
+
+inline void report(const char* group, const char* name, double us)
+{
+	std::printf("%-12s %-48s %12.1f us\n", group, name, us);
+}
+
+void ecs_iteration();
+void math_affine();
+void math_culling();
+void tasks_deque();
+void tasks_alloc();
+}
@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include <runtime/ecs/ecs.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+struct bench_component : runtime::component_impl<bench_component>
+{
+	float value = 1.0f;
+};
+
+const std::size_t ENTITIES = 1000000;
+const std::size_t REPEATS = 10;
+
+double iterate(runtime::entity_component_system& ecs)
+{
+	return bench::measure(REPEATS, [&ecs]() {
+		float sum = 0.0f;
+		ecs.for_each<bench_component>([&sum](runtime::entity /*unused*/, bench_component& c) { sum += c.value; });
+		bench::keep(sum);
+	});
+}
+
+//-----------------------------------------------------------------------------
+//  Name : churn ()
+/// <summary>
+/// Destroys a third of the entities in random order and creates as many new
+/// ones, the way a running game does, so the allocations get reused.
+/// </summary>
+//-----------------------------------------------------------------------------
+template<typename Assign>
+void churn(runtime::entity_component_system& ecs, std::vector<runtime::entity>& entities, const Assign& assign)
+{
+	std::mt19937 rng(42);
+	std::shuffle(std::begin(entities), std::end(entities), rng);
+
+	const auto destroyed = entities.size() / 3;
+	for(std::size_t i = 0; i < destroyed; ++i)
+	{
+		entities[i].destroy();
+	}
+
+	for(std::size_t i = 0; i < destroyed; ++i)
+	{
+		entities[i] = ecs.create();
+		assign(entities[i]);
+	}
+}
+} // namespace
+
+namespace bench
+{
+void ecs_iteration()
+{
+	// Every component on the heap, how the storage worked before the pools.
+	{
+		runtime::entity_component_system ecs;
+		auto assign = [](runtime::entity e) { e.assign(std::make_shared<bench_component>()); };
+		auto entities = ecs.create_many(ENTITIES);
+		for(auto& e : entities)
+		{
+			assign(e);
+		}
+		churn(ecs, entities, assign);
+		report("ecs", "for_each, heap components", iterate(ecs));
+	}
+
+	// Pooled components, before and after the sync point reorders the members.
+	{
+		runtime::entity_component_system ecs;
+		auto assign = [](runtime::entity e) { e.assign<bench_component>(); };
+		auto entities = ecs.create_many(ENTITIES);
+		for(auto& e : entities)
+		{
+			assign(e);
+		}
+		churn(ecs, entities, assign);
+		report("ecs", "for_each, pooled components", iterate(ecs));
+		ecs.playback_commands();
+		report("ecs", "for_each, pooled components, sorted", iterate(ecs));
+	}
+}
+}
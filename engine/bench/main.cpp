@@ -0,0 +1,11 @@
+#include "bench.h"
+
+int main()
+{
+	bench::ecs_iteration();
+	bench::math_affine();
+	bench::math_culling();
+	bench::tasks_deque();
+	bench::tasks_alloc();
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include <core/math/math_includes.h>
+
+#include <vector>
+
+namespace
+{
+const std::size_t NODES = 100000;
+const std::size_t REPEATS = 20;
+
+//-----------------------------------------------------------------------------
+//  Name : make_locals ()
+/// <summary>
+/// Local transforms with rotation, non uniform scale and translation so
+/// neither path can take a shortcut.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<math::transform> make_locals()
+{
+	std::vector<math::transform> locals(NODES);
+	for(std::size_t i = 0; i < NODES; ++i)
+	{
+		const auto f = static_cast<float>(i);
+		locals[i].set_position({f * 0.01f, 1.0f, -f * 0.02f});
+		locals[i].set_rotation_euler({f * 0.001f, f * 0.002f, 0.3f});
+		locals[i].set_scale({1.0f, 1.001f, 0.999f});
+	}
+	return locals;
+}
+
+/// Parents come before their children, the order transform_system resolves in.
+std::size_t parent_of(std::size_t i)
+{
+	return (i - 1) / 4;
+}
+} // namespace
+
+namespace bench
+{
+void math_affine()
+{
+	using mat4 = math::transform::mat4_t;
+
+	const auto locals = make_locals();
+	std::vector<mat4> local_matrices(NODES);
+	std::vector<math::affine3x4> local_affines(NODES);
+	for(std::size_t i = 0; i < NODES; ++i)
+	{
+		local_matrices[i] = locals[i].get_matrix();
+		local_affines[i] = math::affine3x4(locals[i]);
+	}
+
+	std::vector<mat4> world_matrices(NODES);
+	const auto hierarchy_mat4 = measure(REPEATS, [&]() {
+		world_matrices[0] = local_matrices[0];
+		for(std::size_t i = 1; i < NODES; ++i)
+		{
+			world_matrices[i] = world_matrices[parent_of(i)] * local_matrices[i];
+		}
+		keep(world_matrices[NODES - 1][3][0]);
+	});
+	report("math", "hierarchy, mat4", hierarchy_mat4);
+
+	std::vector<math::affine3x4> world_affines(NODES);
+	const auto hierarchy_affine = measure(REPEATS, [&]() {
+		world_affines[0] = local_affines[0];
+		for(std::size_t i = 1; i < NODES; ++i)
+		{
+			world_affines[i] = world_affines[parent_of(i)] * local_affines[i];
+		}
+		keep(world_affines[NODES - 1][0][3]);
+	});
+	report("math", "hierarchy, affine3x4", hierarchy_affine);
+
+	const auto inverse_mat4 = measure(REPEATS, [&]() {
+		float sum = 0.0f;
+		for(const auto& m : world_matrices)
+		{
+			sum += glm::inverse(m)[3][0];
+		}
+		keep(sum);
+	});
+	report("math", "inverse, mat4", inverse_mat4);
+
+	const auto inverse_affine = measure(REPEATS, [&]() {
+		float sum = 0.0f;
+		for(const auto& a : world_affines)
+		{
+			sum += math::inverse(a)[0][3];
+		}
+		keep(sum);
+	});
+	report("math", "inverse, affine3x4", inverse_affine);
+
+	const auto coord_mat4 = measure(REPEATS, [&]() {
+		math::vec3 sum(0.0f);
+		for(const auto& m : world_matrices)
+		{
+			sum += math::vec3(m * math::vec4(1.0f, 2.0f, 3.0f, 1.0f));
+		}
+		keep(sum.x + sum.y + sum.z);
+	});
+	report("math", "transform_coord, mat4", coord_mat4);
+
+	const auto coord_affine = measure(REPEATS, [&]() {
+		math::vec3 sum(0.0f);
+		for(const auto& a : world_affines)
+		{
+			sum += a.transform_coord({1.0f, 2.0f, 3.0f});
+		}
+		keep(sum.x + sum.y + sum.z);
+	});
+	report("math", "transform_coord, affine3x4", coord_affine);
+}
+}
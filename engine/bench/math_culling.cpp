@@ -0,0 +1,53 @@
+#include "bench.h"
+
+#include <core/math/math_includes.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+const std::size_t OBJECTS = 100000;
+const std::size_t REPEATS = 20;
+} // namespace
+
+namespace bench
+{
+void math_culling()
+{
+	// A box shaped frustum covering about an eighth of the scattered objects.
+	const math::frustum frustum(math::bbox(-50.0f, -50.0f, -50.0f, 50.0f, 50.0f, 50.0f));
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+
+	const math::bbox bounds_template(-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f);
+	std::vector<math::bbox> bounds(OBJECTS, bounds_template);
+	std::vector<math::transform> transforms(OBJECTS);
+	std::vector<math::affine3x4> affines(OBJECTS);
+	for(std::size_t i = 0; i < OBJECTS; ++i)
+	{
+		transforms[i].set_position({position(rng), position(rng), position(rng)});
+		transforms[i].set_rotation_euler({angle(rng), angle(rng), angle(rng)});
+		affines[i] = math::affine3x4(transforms[i]);
+	}
+
+	const auto one_by_one = measure(REPEATS, [&]() {
+		std::size_t visible = 0;
+		for(std::size_t i = 0; i < OBJECTS; ++i)
+		{
+			visible += math::frustum::test_obb(frustum, bounds[i], transforms[i]) ? 1 : 0;
+		}
+		keep(visible);
+	});
+	report("culling", "test_obb, one at a time", one_by_one);
+
+	std::vector<std::uint32_t> visibility;
+	const auto batched = measure(REPEATS, [&]() {
+		frustum.test_obbs(bounds.data(), affines.data(), OBJECTS, visibility);
+		keep(visibility.front());
+	});
+	report("culling", "test_obbs, batched", batched);
+}
+}
@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#include <core/tasks/task_system.h>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace
+{
+const int BATCH = 1024;
+const int ROUNDS = 100;
+const std::size_t REPEATS = 10;
+} // namespace
+
+namespace bench
+{
+void tasks_alloc()
+{
+	// A pooled task state holding the callable and, once run, its result.
+	std::vector<std::pair<core::task, core::task_future<int>>> pooled;
+	pooled.reserve(BATCH);
+	const auto pooled_time = measure(REPEATS, [&pooled]() {
+		int sum = 0;
+		for(int round = 0; round < ROUNDS; ++round)
+		{
+			for(int i = 0; i < BATCH; ++i)
+			{
+				pooled.emplace_back(core::task::make_ready_task([i]() { return i; }));
+			}
+			for(auto& p : pooled)
+			{
+				p.first();
+				sum += p.second.get();
+			}
+			pooled.clear();
+		}
+		keep(sum);
+	});
+	report("tasks", "create, run and get, pooled task state", pooled_time);
+
+	// How tasks were stored before, a type erased wrapper around a
+	// packaged_task and its separately allocated shared state.
+	std::vector<std::function<void()>> packaged;
+	std::vector<std::future<int>> futures;
+	packaged.reserve(BATCH);
+	futures.reserve(BATCH);
+	const auto packaged_time = measure(REPEATS, [&packaged, &futures]() {
+		int sum = 0;
+		for(int round = 0; round < ROUNDS; ++round)
+		{
+			for(int i = 0; i < BATCH; ++i)
+			{
+				auto t = std::make_shared<std::packaged_task<int()>>([i]() { return i; });
+				futures.emplace_back(t->get_future());
+				packaged.emplace_back([t]() { (*t)(); });
+			}
+			for(std::size_t i = 0; i < packaged.size(); ++i)
+			{
+				packaged[i]();
+				sum += futures[i].get();
+			}
+			packaged.clear();
+			futures.clear();
+		}
+		keep(sum);
+	});
+	report("tasks", "create, run and get, packaged_task", packaged_time);
+
+	// The whole path, through the queues and the workers.
+	core::task_system tasks(true);
+	std::vector<core::task_future<int>> pushed;
+	pushed.reserve(BATCH);
+	const auto pushed_time = measure(REPEATS, [&tasks, &pushed]() {
+		int sum = 0;
+		for(int round = 0; round < ROUNDS; ++round)
+		{
+			for(int i = 0; i < BATCH; ++i)
+			{
+				pushed.emplace_back(tasks.push_on_worker_thread([i]() { return i; }));
+			}
+			for(auto& f : pushed)
+			{
+				sum += f.get();
+			}
+			pushed.clear();
+		}
+		keep(sum);
+	});
+	report("tasks", "push_on_worker_thread and get", pushed_time);
+}
+}
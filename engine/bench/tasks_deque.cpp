@@ -0,0 +1,146 @@
+#include "bench.h"
+
+#include <core/tasks/task_system.h>
+#include <core/tasks/work_stealing_deque.hpp>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const std::size_t BATCH = 256;
+const std::size_t ROUNDS = 4000;
+const std::size_t REPEATS = 5;
+
+//-----------------------------------------------------------------------------
+//  Name : locked_deque (Class)
+/// <summary>
+/// The same interface as work_stealing_deque behind one mutex, what the
+/// worker queues looked like before.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+class locked_deque
+{
+public:
+	void push(T item)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		items_.push_back(item);
+	}
+
+	T pop()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(items_.empty())
+		{
+			return nullptr;
+		}
+		auto item = items_.back();
+		items_.pop_back();
+		return item;
+	}
+
+	T steal()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(items_.empty())
+		{
+			return nullptr;
+		}
+		auto item = items_.front();
+		items_.pop_front();
+		return item;
+	}
+
+private:
+	std::mutex mutex_;
+	std::deque<T> items_;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : contend ()
+/// <summary>
+/// The owner pushes batches and pops them back while every other hardware
+/// thread keeps stealing, the access pattern of a busy worker.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename Deque>
+double contend(Deque& deque)
+{
+	std::vector<int> items(BATCH);
+	std::atomic<bool> stop{false};
+	std::atomic<std::size_t> stolen{0};
+
+	const auto thieves_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	std::vector<std::thread> thieves;
+	for(unsigned int i = 0; i < thieves_count; ++i)
+	{
+		thieves.emplace_back([&deque, &stop, &stolen]() {
+			while(!stop.load(std::memory_order_relaxed))
+			{
+				if(deque.steal())
+				{
+					stolen.fetch_add(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	const auto time = bench::measure(REPEATS, [&deque, &items]() {
+		for(std::size_t round = 0; round < ROUNDS; ++round)
+		{
+			for(auto& item : items)
+			{
+				deque.push(&item);
+			}
+			while(deque.pop())
+			{
+			}
+		}
+	});
+
+	stop = true;
+	for(auto& thief : thieves)
+	{
+		thief.join();
+	}
+	bench::keep(stolen.load());
+	return time;
+}
+} // namespace
+
+namespace bench
+{
+void tasks_deque()
+{
+	{
+		locked_deque<int*> deque;
+		report("tasks", "push/pop under steals, mutex deque", contend(deque));
+	}
+	{
+		core::work_stealing_deque<int*> deque;
+		report("tasks", "push/pop under steals, work stealing deque", contend(deque));
+	}
+
+	// Many tiny chunks, each one a task pushed and popped or stolen.
+	core::task_system tasks(true);
+	std::vector<float> values(1 << 20, 1.0f);
+	const auto fork_join = measure(REPEATS, [&tasks, &values]() {
+		tasks.parallel_for(0, values.size(), 64, [&values](std::size_t begin, std::size_t end) {
+			for(auto i = begin; i < end; ++i)
+			{
+				values[i] *= 1.0001f;
+			}
+		});
+	});
+	report("tasks", "parallel_for, 16k chunks of 64", fork_join);
+}
+}
@@ -0,0 +1,442 @@
+#pragma once
+//-----------------------------------------------------------------------------
+// affine3x4 Header Includes
+//-----------------------------------------------------------------------------
+#include "transform.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_AFFINE_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MATH_AFFINE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace math
+{
+namespace detail
+{
+//-----------------------------------------------------------------------------
+// Minimal 4 wide float abstraction used by affine3x4, the batched frustum
+// tests and the occlusion buffer. Maps to SSE, NEON or plain scalar code depending on the target.
+//-----------------------------------------------------------------------------
+#if defined(MATH_AFFINE_SSE)
+using float4 = __m128;
+
+inline float4 load4(const float* p)
+{
+	return _mm_load_ps(p);
+}
+inline void store4(float* p, float4 v)
+{
+	_mm_store_ps(p, v);
+}
+inline float4 set4(float x, float y, float z, float w)
+{
+	return _mm_set_ps(w, z, y, x);
+}
+inline float4 add4(float4 a, float4 b)
+{
+	return _mm_add_ps(a, b);
+}
+inline float4 sub4(float4 a, float4 b)
+{
+	return _mm_sub_ps(a, b);
+}
+inline float4 mul4(float4 a, float4 b)
+{
+	return _mm_mul_ps(a, b);
+}
+template <int I>
+inline float4 splat4(float4 v)
+{
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I));
+}
+/// (y, z, x, w)
+inline float4 yzx4(float4 v)
+{
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+inline void transpose4(float4& r0, float4& r1, float4& r2, float4& r3)
+{
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+inline float4 abs4(float4 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+/// Bit i is set when lane i of 'a' is greater than lane i of 'b'.
+inline int gt_mask4(float4 a, float4 b)
+{
+	return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+}
+inline float4 min4(float4 a, float4 b)
+{
+	return _mm_min_ps(a, b);
+}
+inline float4 max4(float4 a, float4 b)
+{
+	return _mm_max_ps(a, b);
+}
+/// Lanes of 'v' where the matching lane of 'test' is >= 0, 0 elsewhere.
+inline float4 keep_ge_zero4(float4 test, float4 v)
+{
+	return _mm_and_ps(_mm_cmpge_ps(test, _mm_setzero_ps()), v);
+}
+#elif defined(MATH_AFFINE_NEON)
+using float4 = float32x4_t;
+
+inline float4 load4(const float* p)
+{
+	return vld1q_f32(p);
+}
+inline void store4(float* p, float4 v)
+{
+	vst1q_f32(p, v);
+}
+inline float4 set4(float x, float y, float z, float w)
+{
+	const float v[4] = {x, y, z, w};
+	return vld1q_f32(v);
+}
+inline float4 add4(float4 a, float4 b)
+{
+	return vaddq_f32(a, b);
+}
+inline float4 sub4(float4 a, float4 b)
+{
+	return vsubq_f32(a, b);
+}
+inline float4 mul4(float4 a, float4 b)
+{
+	return vmulq_f32(a, b);
+}
+template <int I>
+inline float4 splat4(float4 v)
+{
+	return vdupq_n_f32(vgetq_lane_f32(v, I));
+}
+/// (y, z, x, x) the last lane is not preserved
+inline float4 yzx4(float4 v)
+{
+	return vsetq_lane_f32(vgetq_lane_f32(v, 0), vextq_f32(v, v, 1), 2);
+}
+inline void transpose4(float4& r0, float4& r1, float4& r2, float4& r3)
+{
+	const float32x4x2_t t0 = vzipq_f32(r0, r2);
+	const float32x4x2_t t1 = vzipq_f32(r1, r3);
+	const float32x4x2_t c01 = vzipq_f32(t0.val[0], t1.val[0]);
+	const float32x4x2_t c23 = vzipq_f32(t0.val[1], t1.val[1]);
+	r0 = c01.val[0];
+	r1 = c01.val[1];
+	r2 = c23.val[0];
+	r3 = c23.val[1];
+}
+inline float4 abs4(float4 v)
+{
+	return vabsq_f32(v);
+}
+/// Bit i is set when lane i of 'a' is greater than lane i of 'b'.
+inline int gt_mask4(float4 a, float4 b)
+{
+	const uint32x4_t m = vcgtq_f32(a, b);
+	return int((vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) | (vgetq_lane_u32(m, 2) & 4) |
+			   (vgetq_lane_u32(m, 3) & 8));
+}
+inline float4 min4(float4 a, float4 b)
+{
+	return vminq_f32(a, b);
+}
+inline float4 max4(float4 a, float4 b)
+{
+	return vmaxq_f32(a, b);
+}
+/// Lanes of 'v' where the matching lane of 'test' is >= 0, 0 elsewhere.
+inline float4 keep_ge_zero4(float4 test, float4 v)
+{
+	const uint32x4_t m = vcgeq_f32(test, vdupq_n_f32(0.0f));
+	return vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(v)));
+}
+#else
+struct float4
+{
+	float v[4];
+};
+
+inline float4 load4(const float* p)
+{
+	return {{p[0], p[1], p[2], p[3]}};
+}
+inline void store4(float* p, float4 v)
+{
+	p[0] = v.v[0];
+	p[1] = v.v[1];
+	p[2] = v.v[2];
+	p[3] = v.v[3];
+}
+inline float4 set4(float x, float y, float z, float w)
+{
+	return {{x, y, z, w}};
+}
+inline float4 add4(float4 a, float4 b)
+{
+	return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+inline float4 sub4(float4 a, float4 b)
+{
+	return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+inline float4 mul4(float4 a, float4 b)
+{
+	return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+template <int I>
+inline float4 splat4(float4 v)
+{
+	return {{v.v[I], v.v[I], v.v[I], v.v[I]}};
+}
+inline float4 yzx4(float4 v)
+{
+	return {{v.v[1], v.v[2], v.v[0], v.v[3]}};
+}
+inline void transpose4(float4& r0, float4& r1, float4& r2, float4& r3)
+{
+	const float4 c0 = {{r0.v[0], r1.v[0], r2.v[0], r3.v[0]}};
+	const float4 c1 = {{r0.v[1], r1.v[1], r2.v[1], r3.v[1]}};
+	const float4 c2 = {{r0.v[2], r1.v[2], r2.v[2], r3.v[2]}};
+	const float4 c3 = {{r0.v[3], r1.v[3], r2.v[3], r3.v[3]}};
+	r0 = c0;
+	r1 = c1;
+	r2 = c2;
+	r3 = c3;
+}
+inline float4 abs4(float4 v)
+{
+	return {{std::abs(v.v[0]), std::abs(v.v[1]), std::abs(v.v[2]), std::abs(v.v[3])}};
+}
+/// Bit i is set when lane i of 'a' is greater than lane i of 'b'.
+inline int gt_mask4(float4 a, float4 b)
+{
+	return (a.v[0] > b.v[0] ? 1 : 0) | (a.v[1] > b.v[1] ? 2 : 0) | (a.v[2] > b.v[2] ? 4 : 0) |
+		   (a.v[3] > b.v[3] ? 8 : 0);
+}
+inline float4 min4(float4 a, float4 b)
+{
+	return {{a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1],
+			 a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3]}};
+}
+inline float4 max4(float4 a, float4 b)
+{
+	return {{a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1],
+			 a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3]}};
+}
+/// Lanes of 'v' where the matching lane of 'test' is >= 0, 0 elsewhere.
+inline float4 keep_ge_zero4(float4 test, float4 v)
+{
+	return {{test.v[0] >= 0.0f ? v.v[0] : 0.0f, test.v[1] >= 0.0f ? v.v[1] : 0.0f,
+			 test.v[2] >= 0.0f ? v.v[2] : 0.0f, test.v[3] >= 0.0f ? v.v[3] : 0.0f}};
+}
+#endif
+
+/// 3 component cross product, the last lane is undefined.
+inline float4 cross4(float4 a, float4 b)
+{
+	const float4 a_yzx = yzx4(a);
+	const float4 b_yzx = yzx4(b);
+	return yzx4(sub4(mul4(a, b_yzx), mul4(a_yzx, b)));
+}
+} // namespace detail
+
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : affine3x4 (Class)
+/// <summary>
+/// Packed affine transformation stored as the top three rows of a row major
+/// 4x4 matrix, the last row being implicitly (0, 0, 0, 1). It is 48 bytes
+/// against the 100+ of math::transform and composes with SIMD code, which
+/// makes it the type of choice for hot paths such as hierarchy propagation
+/// and skinning. Convert back to math::transform at the boundaries.
+/// </summary>
+//-----------------------------------------------------------------------------
+class alignas(16) affine3x4
+{
+public:
+	using mat4_t = transform::mat4_t;
+	using vec3_t = transform::vec3_t;
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	affine3x4()
+		: rows_{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}}
+	{
+	}
+
+	explicit affine3x4(const mat4_t& m)
+	{
+		// glm matrices are column major
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				rows_[r][c] = m[c][r];
+			}
+		}
+	}
+
+	explicit affine3x4(const transform& t)
+		: affine3x4(t.get_matrix())
+	{
+	}
+
+	//-------------------------------------------------------------------------
+	// Public Methods
+	//-------------------------------------------------------------------------
+	mat4_t to_matrix() const
+	{
+		mat4_t m(1.0f);
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				m[c][r] = rows_[r][c];
+			}
+		}
+		return m;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : to_transform ()
+	/// <summary>
+	/// Decomposes the components once, so that const reads of the result do
+	/// not write to it and can happen from several threads.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	transform to_transform() const
+	{
+		return transform(to_matrix());
+	}
+
+	vec3_t get_position() const
+	{
+		return {rows_[0][3], rows_[1][3], rows_[2][3]};
+	}
+
+	vec3_t transform_coord(const vec3_t& v) const
+	{
+		using namespace detail;
+		float4 c0 = load4(rows_[0]);
+		float4 c1 = load4(rows_[1]);
+		float4 c2 = load4(rows_[2]);
+		float4 c3 = set4(0.0f, 0.0f, 0.0f, 1.0f);
+		transpose4(c0, c1, c2, c3);
+		float4 r = add4(add4(mul4(c0, set4(v.x, v.x, v.x, v.x)), mul4(c1, set4(v.y, v.y, v.y, v.y))),
+						add4(mul4(c2, set4(v.z, v.z, v.z, v.z)), c3));
+		alignas(16) float out[4];
+		store4(out, r);
+		return {out[0], out[1], out[2]};
+	}
+
+	vec3_t transform_normal(const vec3_t& v) const
+	{
+		using namespace detail;
+		float4 c0 = load4(rows_[0]);
+		float4 c1 = load4(rows_[1]);
+		float4 c2 = load4(rows_[2]);
+		float4 c3 = set4(0.0f, 0.0f, 0.0f, 1.0f);
+		transpose4(c0, c1, c2, c3);
+		float4 r = add4(add4(mul4(c0, set4(v.x, v.x, v.x, v.x)), mul4(c1, set4(v.y, v.y, v.y, v.y))),
+						mul4(c2, set4(v.z, v.z, v.z, v.z)));
+		alignas(16) float out[4];
+		store4(out, r);
+		return {out[0], out[1], out[2]};
+	}
+
+	//-------------------------------------------------------------------------
+	// Public Operator Overloads
+	//-------------------------------------------------------------------------
+	affine3x4 operator*(const affine3x4& rhs) const
+	{
+		using namespace detail;
+		const float4 b0 = load4(rhs.rows_[0]);
+		const float4 b1 = load4(rhs.rows_[1]);
+		const float4 b2 = load4(rhs.rows_[2]);
+		const float4 w = set4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		affine3x4 result;
+		for(int r = 0; r < 3; ++r)
+		{
+			// row r of the product, the translation of lhs is carried over
+			// through the implicit (0, 0, 0, 1) last row of rhs.
+			const float4 a = load4(rows_[r]);
+			const float4 row = add4(add4(mul4(splat4<0>(a), b0), mul4(splat4<1>(a), b1)),
+									add4(mul4(splat4<2>(a), b2), mul4(splat4<3>(a), w)));
+			store4(result.rows_[r], row);
+		}
+		return result;
+	}
+
+	const float* operator[](int row) const
+	{
+		return rows_[row];
+	}
+
+private:
+	friend affine3x4 inverse(const affine3x4& t);
+
+	alignas(16) float rows_[3][4];
+};
+
+//-----------------------------------------------------------------------------
+//  Name : inverse ()
+/// <summary>
+/// Inverse of a general affine transform (rotation, scale and shear).
+/// Like glm::inverse the result is undefined for singular transforms.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline affine3x4 inverse(const affine3x4& t)
+{
+	using namespace detail;
+	const float4 r0 = load4(t.rows_[0]);
+	const float4 r1 = load4(t.rows_[1]);
+	const float4 r2 = load4(t.rows_[2]);
+
+	// the columns of the inverse of the upper 3x3 are the cross products of
+	// its rows, divided by the determinant.
+	float4 c0 = cross4(r1, r2);
+	float4 c1 = cross4(r2, r0);
+	float4 c2 = cross4(r0, r1);
+	float4 c3 = set4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	alignas(16) float row0[4];
+	alignas(16) float col0[4];
+	store4(row0, r0);
+	store4(col0, c0);
+	const float inv_det = 1.0f / (row0[0] * col0[0] + row0[1] * col0[1] + row0[2] * col0[2]);
+
+	transpose4(c0, c1, c2, c3);
+	const float4 scale = set4(inv_det, inv_det, inv_det, 0.0f);
+	c0 = mul4(c0, scale);
+	c1 = mul4(c1, scale);
+	c2 = mul4(c2, scale);
+
+	// -inverse(A) * translation
+	const float tx = t.rows_[0][3];
+	const float ty = t.rows_[1][3];
+	const float tz = t.rows_[2][3];
+
+	affine3x4 result;
+	store4(result.rows_[0], c0);
+	store4(result.rows_[1], c1);
+	store4(result.rows_[2], c2);
+	for(int r = 0; r < 3; ++r)
+	{
+		auto& row = result.rows_[r];
+		row[3] = -(row[0] * tx + row[1] * ty + row[2] * tz);
+	}
+	return result;
+}
+} // namespace math
@@ -0,0 +1,460 @@
+#include "bvh.h"
+#include <algorithm>
+
+namespace math
+{
+namespace
+{
+inline bbox merge(const bbox& a, const bbox& b)
+{
+	return bbox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+inline float surface_area(const bbox& b)
+{
+	const auto d = b.max - b.min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+inline bool contains(const bbox& outer, const bbox& inner)
+{
+	return glm::all(glm::lessThanEqual(outer.min, inner.min)) &&
+		   glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+}
+
+const std::int32_t bvh::null_node;
+
+///////////////////////////////////////////////////////////////////////////////
+// bvh Member Functions
+///////////////////////////////////////////////////////////////////////////////
+//-----------------------------------------------------------------------------
+//  Name : bvh () (Constructor)
+/// <summary>
+/// bvh Class Constructor
+/// </summary>
+//-----------------------------------------------------------------------------
+bvh::bvh(float margin)
+	: margin_(margin)
+{
+}
+
+//-----------------------------------------------------------------------------
+//  Name : insert ()
+/// <summary>
+/// Adds a leaf and returns its handle.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::int32_t bvh::insert(const bbox& bounds, std::uint32_t user_data)
+{
+	const auto proxy = allocate_node();
+	auto& leaf = nodes_[std::size_t(proxy)];
+	leaf.item = bounds;
+	leaf.bounds = bounds;
+	leaf.bounds.inflate(margin_);
+	leaf.user_data = user_data;
+	leaf.height = 0;
+
+	insert_leaf(proxy);
+	++leaves_;
+	return proxy;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : remove ()
+/// <summary>
+/// Removes a leaf, its handle must not be used anymore.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bvh::remove(std::int32_t proxy)
+{
+	remove_leaf(proxy);
+	free_node(proxy);
+	--leaves_;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : move ()
+/// <summary>
+/// Updates the bounds of a leaf. The leaf is only reinserted if the new
+/// bounds do not fit in its enlarged bounds anymore, in which case true is
+/// returned.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool bvh::move(std::int32_t proxy, const bbox& bounds)
+{
+	auto& leaf = nodes_[std::size_t(proxy)];
+	leaf.item = bounds;
+	if(contains(leaf.bounds, bounds))
+	{
+		return false;
+	}
+
+	remove_leaf(proxy);
+	auto& moved = nodes_[std::size_t(proxy)];
+	moved.bounds = bounds;
+	moved.bounds.inflate(margin_);
+	insert_leaf(proxy);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : rebuild ()
+/// <summary>
+/// Rebuilds all inner nodes top down, splitting the leaves at the median of
+/// the longest axis of their centres. The leaf handles are preserved.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bvh::rebuild()
+{
+	std::vector<std::int32_t> leaves;
+	leaves.reserve(leaves_);
+	for(std::size_t i = 0; i < nodes_.size(); ++i)
+	{
+		auto& n = nodes_[i];
+		if(n.height < 0)
+		{
+			continue;
+		}
+
+		if(n.is_leaf())
+		{
+			leaves.push_back(std::int32_t(i));
+		}
+		else
+		{
+			free_node(std::int32_t(i));
+		}
+	}
+
+	root_ = null_node;
+	if(leaves.empty())
+	{
+		return;
+	}
+
+	root_ = build(leaves.data(), leaves.data() + leaves.size());
+	nodes_[std::size_t(root_)].parent = null_node;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : clear ()
+/// <summary>
+/// Removes all leaves.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bvh::clear()
+{
+	nodes_.clear();
+	root_ = null_node;
+	free_list_ = null_node;
+	leaves_ = 0;
+}
+
+std::int32_t bvh::allocate_node()
+{
+	if(free_list_ == null_node)
+	{
+		nodes_.emplace_back();
+		return std::int32_t(nodes_.size() - 1);
+	}
+
+	const auto index = free_list_;
+	auto& n = nodes_[std::size_t(index)];
+	free_list_ = n.parent;
+	n = node();
+	return index;
+}
+
+void bvh::free_node(std::int32_t index)
+{
+	auto& n = nodes_[std::size_t(index)];
+	n.parent = free_list_;
+	n.left = null_node;
+	n.right = null_node;
+	n.height = -1;
+	free_list_ = index;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : insert_leaf ()
+/// <summary>
+/// Walks down to the sibling with the lowest surface area cost, pairs the
+/// leaf with it under a new parent and rebalances on the way back up.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bvh::insert_leaf(std::int32_t leaf)
+{
+	if(root_ == null_node)
+	{
+		root_ = leaf;
+		nodes_[std::size_t(leaf)].parent = null_node;
+		return;
+	}
+
+	const auto leaf_bounds = nodes_[std::size_t(leaf)].bounds;
+	auto index = root_;
+	while(!nodes_[std::size_t(index)].is_leaf())
+	{
+		const auto& n = nodes_[std::size_t(index)];
+		const float area = surface_area(n.bounds);
+		const float combined_area = surface_area(merge(n.bounds, leaf_bounds));
+
+		// Cost of creating a new parent for this node and the new leaf, and
+		// the minimum cost of pushing the leaf further down the tree.
+		const float cost = 2.0f * combined_area;
+		const float inheritance_cost = 2.0f * (combined_area - area);
+
+		auto child_cost = [&](std::int32_t child) {
+			const auto& c = nodes_[std::size_t(child)];
+			const float merged = surface_area(merge(c.bounds, leaf_bounds));
+			return (c.is_leaf() ? merged : merged - surface_area(c.bounds)) + inheritance_cost;
+		};
+		const float cost_left = child_cost(n.left);
+		const float cost_right = child_cost(n.right);
+
+		if(cost < cost_left && cost < cost_right)
+		{
+			break;
+		}
+
+		index = cost_left < cost_right ? n.left : n.right;
+	}
+
+	const auto sibling = index;
+	const auto old_parent = nodes_[std::size_t(sibling)].parent;
+	const auto new_parent = allocate_node();
+	{
+		auto& p = nodes_[std::size_t(new_parent)];
+		p.parent = old_parent;
+		p.bounds = merge(leaf_bounds, nodes_[std::size_t(sibling)].bounds);
+		p.height = nodes_[std::size_t(sibling)].height + 1;
+		p.left = sibling;
+		p.right = leaf;
+	}
+
+	if(old_parent != null_node)
+	{
+		auto& op = nodes_[std::size_t(old_parent)];
+		if(op.left == sibling)
+		{
+			op.left = new_parent;
+		}
+		else
+		{
+			op.right = new_parent;
+		}
+	}
+	else
+	{
+		root_ = new_parent;
+	}
+	nodes_[std::size_t(sibling)].parent = new_parent;
+	nodes_[std::size_t(leaf)].parent = new_parent;
+
+	refit(nodes_[std::size_t(leaf)].parent);
+}
+
+void bvh::remove_leaf(std::int32_t leaf)
+{
+	if(leaf == root_)
+	{
+		root_ = null_node;
+		return;
+	}
+
+	const auto parent = nodes_[std::size_t(leaf)].parent;
+	const auto grand_parent = nodes_[std::size_t(parent)].parent;
+	const auto& p = nodes_[std::size_t(parent)];
+	const auto sibling = p.left == leaf ? p.right : p.left;
+
+	if(grand_parent != null_node)
+	{
+		auto& gp = nodes_[std::size_t(grand_parent)];
+		if(gp.left == parent)
+		{
+			gp.left = sibling;
+		}
+		else
+		{
+			gp.right = sibling;
+		}
+		nodes_[std::size_t(sibling)].parent = grand_parent;
+		free_node(parent);
+		refit(grand_parent);
+	}
+	else
+	{
+		root_ = sibling;
+		nodes_[std::size_t(sibling)].parent = null_node;
+		free_node(parent);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : refit ()
+/// <summary>
+/// Rebalances and recomputes the bounds and heights from 'index' up to the
+/// root.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bvh::refit(std::int32_t index)
+{
+	while(index != null_node)
+	{
+		index = balance(index);
+
+		auto& n = nodes_[std::size_t(index)];
+		const auto& left = nodes_[std::size_t(n.left)];
+		const auto& right = nodes_[std::size_t(n.right)];
+		n.height = 1 + std::max(left.height, right.height);
+		n.bounds = merge(left.bounds, right.bounds);
+
+		index = n.parent;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : balance ()
+/// <summary>
+/// Rotates the taller grandchild up if the subtree rooted at 'index' is
+/// unbalanced. Returns the new root of the subtree.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::int32_t bvh::balance(std::int32_t index)
+{
+	const auto ia = index;
+	auto& a = nodes_[std::size_t(ia)];
+	if(a.is_leaf() || a.height < 2)
+	{
+		return ia;
+	}
+
+	const auto ib = a.left;
+	const auto ic = a.right;
+	auto& b = nodes_[std::size_t(ib)];
+	auto& c = nodes_[std::size_t(ic)];
+	const auto difference = c.height - b.height;
+
+	// Moves 'up' into the place of 'a', 'a' taking the place of 'up' and
+	// keeping 'keep' and the shorter grandchild.
+	auto rotate = [&](std::int32_t iup, std::int32_t ikeep, std::int32_t& a_slot) {
+		auto& up = nodes_[std::size_t(iup)];
+		const auto& keep = nodes_[std::size_t(ikeep)];
+		const auto ig0 = up.left;
+		const auto ig1 = up.right;
+		auto& g0 = nodes_[std::size_t(ig0)];
+		auto& g1 = nodes_[std::size_t(ig1)];
+
+		up.left = ia;
+		up.parent = a.parent;
+		a.parent = iup;
+
+		if(up.parent != null_node)
+		{
+			auto& up_parent = nodes_[std::size_t(up.parent)];
+			if(up_parent.left == ia)
+			{
+				up_parent.left = iup;
+			}
+			else
+			{
+				up_parent.right = iup;
+			}
+		}
+		else
+		{
+			root_ = iup;
+		}
+
+		const bool first_taller = g0.height > g1.height;
+		const auto itall = first_taller ? ig0 : ig1;
+		const auto ishort = first_taller ? ig1 : ig0;
+		auto& tall = nodes_[std::size_t(itall)];
+		auto& low = nodes_[std::size_t(ishort)];
+
+		up.right = itall;
+		a_slot = ishort;
+		low.parent = ia;
+		a.bounds = merge(keep.bounds, low.bounds);
+		up.bounds = merge(a.bounds, tall.bounds);
+		a.height = 1 + std::max(keep.height, low.height);
+		up.height = 1 + std::max(a.height, tall.height);
+	};
+
+	if(difference > 1)
+	{
+		rotate(ic, ib, a.right);
+		return ic;
+	}
+
+	if(difference < -1)
+	{
+		rotate(ib, ic, a.left);
+		return ib;
+	}
+
+	return ia;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : build ()
+/// <summary>
+/// Builds the inner nodes over the leaves in [first, last) and returns the
+/// root of the subtree.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::int32_t bvh::build(std::int32_t* first, std::int32_t* last)
+{
+	const auto count = last - first;
+	if(count == 1)
+	{
+		return *first;
+	}
+
+	auto center = [this](std::int32_t leaf) {
+		const auto& b = nodes_[std::size_t(leaf)].bounds;
+		return b.min + b.max;
+	};
+
+	vec3 lo = center(*first);
+	vec3 hi = lo;
+	for(auto it = first + 1; it != last; ++it)
+	{
+		const auto c = center(*it);
+		lo = glm::min(lo, c);
+		hi = glm::max(hi, c);
+	}
+
+	const auto extent = hi - lo;
+	int axis = 0;
+	if(extent.y > extent[axis])
+	{
+		axis = 1;
+	}
+	if(extent.z > extent[axis])
+	{
+		axis = 2;
+	}
+
+	auto middle = first + count / 2;
+	std::nth_element(first, middle, last, [&](std::int32_t l, std::int32_t r) {
+		return center(l)[axis] < center(r)[axis];
+	});
+
+	const auto left = build(first, middle);
+	const auto right = build(middle, last);
+	const auto index = allocate_node();
+
+	auto& n = nodes_[std::size_t(index)];
+	auto& l = nodes_[std::size_t(left)];
+	auto& r = nodes_[std::size_t(right)];
+	n.left = left;
+	n.right = right;
+	n.bounds = merge(l.bounds, r.bounds);
+	n.height = 1 + std::max(l.height, r.height);
+	l.parent = index;
+	r.parent = index;
+	return index;
+}
+}
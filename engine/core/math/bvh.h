@@ -0,0 +1,259 @@
+#pragma once
+
+#include "bbox.h"
+#include "bsphere.h"
+#include "frustum.h"
+#include "math_types.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace math
+{
+using namespace glm;
+
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : bvh (Class)
+/// <summary>
+/// Dynamic bounding volume hierarchy of axis aligned boxes. Leaves are
+/// inserted next to the sibling that grows the tree surface the least and
+/// the tree is kept balanced with rotations, so every operation is
+/// logarithmic. Leaf boxes are enlarged by 'margin' so that objects moving
+/// a little do not need to be reinserted. rebuild() replaces the inner
+/// nodes with a top down median split, which makes a better tree for
+/// content that rarely changes.
+/// The handle returned by insert() stays valid until the leaf is removed.
+/// </summary>
+//-----------------------------------------------------------------------------
+class bvh
+{
+public:
+	static const std::int32_t null_node = -1;
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	explicit bvh(float margin = 0.0f);
+
+	//-------------------------------------------------------------------------
+	// Public Methods
+	//-------------------------------------------------------------------------
+	std::int32_t insert(const bbox& bounds, std::uint32_t user_data);
+	void remove(std::int32_t proxy);
+	bool move(std::int32_t proxy, const bbox& bounds);
+	void rebuild();
+	void clear();
+
+	inline std::uint32_t get_user_data(std::int32_t proxy) const
+	{
+		return nodes_[std::size_t(proxy)].user_data;
+	}
+
+	/// the exact bounds the leaf was inserted or moved with
+	inline const bbox& get_bounds(std::int32_t proxy) const
+	{
+		return nodes_[std::size_t(proxy)].item;
+	}
+
+	inline std::size_t size() const
+	{
+		return leaves_;
+	}
+
+	inline std::int32_t get_height() const
+	{
+		return root_ == null_node ? 0 : nodes_[std::size_t(root_)].height;
+	}
+
+	//-------------------------------------------------------------------------
+	//  Name : query ()
+	/// <summary>
+	/// Calls f(user_data) for every leaf whose bounds intersect the volume.
+	/// </summary>
+	//-------------------------------------------------------------------------
+	template <typename F>
+	void query(const bbox& bounds, F&& f) const
+	{
+		traverse([&bounds](const bbox& node_bounds) { return node_bounds.intersect(bounds); },
+				 [&bounds](const bbox& item) { return item.intersect(bounds); }, f);
+	}
+
+	template <typename F>
+	void query(const bsphere& sphere, F&& f) const
+	{
+		auto overlaps = [&sphere](const bbox& box) {
+			const auto offset = box.closest_point(sphere.position) - sphere.position;
+			return dot(offset, offset) <= sphere.radius * sphere.radius;
+		};
+		traverse(overlaps, overlaps, f);
+	}
+
+	template <typename F>
+	void query(const frustum& f, F&& fn) const;
+
+	//-------------------------------------------------------------------------
+	//  Name : query_ray ()
+	/// <summary>
+	/// Calls f(user_data, t) for every leaf hit by the segment going from
+	/// 'origin' to 'origin + velocity', t being the entry point as a
+	/// fraction of 'velocity'. The leaves are not sorted by distance.
+	/// </summary>
+	//-------------------------------------------------------------------------
+	template <typename F>
+	void query_ray(const vec3& origin, const vec3& velocity, F&& f) const
+	{
+		float t = 0.0f;
+		traverse([&](const bbox& node_bounds) { return node_bounds.intersect(origin, velocity, t, true); },
+				 [&](const bbox& item) { return item.intersect(origin, velocity, t, true); },
+				 [&](std::uint32_t user_data) { f(user_data, t); });
+	}
+
+private:
+	struct node
+	{
+		/// bounds of the subtree, enlarged by the margin for leaves
+		bbox bounds;
+		/// exact bounds of the leaf
+		bbox item;
+		/// parent node, or next free node while in the free list
+		std::int32_t parent = null_node;
+		std::int32_t left = null_node;
+		std::int32_t right = null_node;
+		/// 0 for leaves, -1 for free nodes
+		std::int32_t height = 0;
+		std::uint32_t user_data = 0;
+
+		inline bool is_leaf() const
+		{
+			return left == null_node;
+		}
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Methods
+	//-------------------------------------------------------------------------
+	std::int32_t allocate_node();
+	void free_node(std::int32_t index);
+	void insert_leaf(std::int32_t leaf);
+	void remove_leaf(std::int32_t leaf);
+	void refit(std::int32_t index);
+	std::int32_t balance(std::int32_t index);
+	std::int32_t build(std::int32_t* first, std::int32_t* last);
+
+	template <typename Overlap, typename Test, typename F>
+	void traverse(Overlap&& overlap, Test&& test, F&& f) const
+	{
+		if(root_ == null_node)
+		{
+			return;
+		}
+
+		std::vector<std::int32_t> stack;
+		stack.reserve(64);
+		stack.push_back(root_);
+		while(!stack.empty())
+		{
+			const auto& n = nodes_[std::size_t(stack.back())];
+			stack.pop_back();
+			if(!overlap(n.bounds))
+			{
+				continue;
+			}
+
+			if(n.is_leaf())
+			{
+				if(test(n.item))
+				{
+					f(n.user_data);
+				}
+				continue;
+			}
+
+			stack.push_back(n.left);
+			stack.push_back(n.right);
+		}
+	}
+
+	template <typename F>
+	void report_all(std::int32_t index, std::vector<std::int32_t>& stack, F& f) const
+	{
+		const auto base = stack.size();
+		stack.push_back(index);
+		while(stack.size() > base)
+		{
+			const auto& n = nodes_[std::size_t(stack.back())];
+			stack.pop_back();
+			if(n.is_leaf())
+			{
+				f(n.user_data);
+				continue;
+			}
+
+			stack.push_back(n.left);
+			stack.push_back(n.right);
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	// Private Member Variables
+	//-------------------------------------------------------------------------
+	std::vector<node> nodes_;
+	std::int32_t root_ = null_node;
+	std::int32_t free_list_ = null_node;
+	std::size_t leaves_ = 0;
+	float margin_ = 0.0f;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : query () (Frustum)
+/// <summary>
+/// Subtrees entirely inside the frustum are reported without testing their
+/// leaves one by one.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename F>
+void bvh::query(const frustum& f, F&& fn) const
+{
+	if(root_ == null_node)
+	{
+		return;
+	}
+
+	std::vector<std::int32_t> stack;
+	stack.reserve(64);
+	stack.push_back(root_);
+	while(!stack.empty())
+	{
+		const auto index = stack.back();
+		const auto& n = nodes_[std::size_t(index)];
+		stack.pop_back();
+
+		const auto result = f.classify_aabb(n.bounds);
+		if(result == volume_query::outside)
+		{
+			continue;
+		}
+
+		if(result == volume_query::inside)
+		{
+			report_all(index, stack, fn);
+			continue;
+		}
+
+		if(n.is_leaf())
+		{
+			if(f.test_aabb(n.item))
+			{
+				fn(n.user_data);
+			}
+			continue;
+		}
+
+		stack.push_back(n.left);
+		stack.push_back(n.right);
+	}
+}
+}
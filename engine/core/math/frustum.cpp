@@ -1,4 +1,5 @@
 #include "frustum.h"
+#include <algorithm>
 
 namespace math
 {
@@ -506,6 +507,165 @@ bool frustum::test_obb(frustum frustum, const bbox& AABB, const transform& t)
 	return frustum.test_aabb(AABB);
 }
 
+namespace
+{
+//-----------------------------------------------------------------------------
+// Four world space boxes in SoA layout, each one described by its centre and
+// its three half extent axes.
+//-----------------------------------------------------------------------------
+struct box_batch
+{
+	alignas(16) float center[3][4];
+	alignas(16) float axes[3][3][4];
+};
+
+void fill_lane(box_batch& batch, int lane, const bbox& bounds, const affine3x4& t)
+{
+	const auto center = bounds.get_center();
+	const auto extents = bounds.get_extents();
+	for(int c = 0; c < 3; ++c)
+	{
+		const float* row = t[c];
+		batch.center[c][lane] = row[0] * center.x + row[1] * center.y + row[2] * center.z + row[3];
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			batch.axes[axis][c][lane] = row[axis] * extents[axis];
+		}
+	}
+}
+
+void fill_lane(box_batch& batch, int lane, const bbox& bounds)
+{
+	const auto center = bounds.get_center();
+	const auto extents = bounds.get_extents();
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		batch.center[axis][lane] = center[axis];
+		for(int c = 0; c < 3; ++c)
+		{
+			batch.axes[axis][c][lane] = axis == c ? extents[axis] : 0.0f;
+		}
+	}
+}
+
+void clear_lane(box_batch& batch, int lane)
+{
+	for(int c = 0; c < 3; ++c)
+	{
+		batch.center[c][lane] = 0.0f;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			batch.axes[axis][c][lane] = 0.0f;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : outside_mask ()
+/// <summary>
+/// Bit i of the result is set when box i of the batch is entirely on the
+/// outer side of one of the planes. Same test as test_aabb, with the
+/// projected radius of the box standing in for its near point.
+/// </summary>
+//-----------------------------------------------------------------------------
+int outside_mask(const std::array<plane, 6>& planes, const box_batch& batch)
+{
+	using namespace detail;
+	const float4 cx = load4(batch.center[0]);
+	const float4 cy = load4(batch.center[1]);
+	const float4 cz = load4(batch.center[2]);
+	float4 ax[3];
+	float4 ay[3];
+	float4 az[3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		ax[axis] = load4(batch.axes[axis][0]);
+		ay[axis] = load4(batch.axes[axis][1]);
+		az[axis] = load4(batch.axes[axis][2]);
+	}
+
+	const float4 zero = set4(0.0f, 0.0f, 0.0f, 0.0f);
+	int outside = 0;
+	for(const auto& p : planes)
+	{
+		const float4 nx = set4(p.data.x, p.data.x, p.data.x, p.data.x);
+		const float4 ny = set4(p.data.y, p.data.y, p.data.y, p.data.y);
+		const float4 nz = set4(p.data.z, p.data.z, p.data.z, p.data.z);
+		const float4 nw = set4(p.data.w, p.data.w, p.data.w, p.data.w);
+
+		const float4 distance = add4(add4(mul4(nx, cx), mul4(ny, cy)), add4(mul4(nz, cz), nw));
+		float4 radius = zero;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			const float4 d = add4(add4(mul4(nx, ax[axis]), mul4(ny, ay[axis])), mul4(nz, az[axis]));
+			radius = add4(radius, abs4(d));
+		}
+
+		outside |= gt_mask4(sub4(distance, radius), zero);
+	}
+	return outside;
+}
+
+template <typename Fill>
+void test_boxes(const std::array<plane, 6>& planes, std::size_t count, std::vector<std::uint32_t>& visibility,
+				Fill fill)
+{
+	visibility.assign((count + 31) / 32, 0u);
+
+	box_batch batch;
+	for(std::size_t first = 0; first < count; first += 4)
+	{
+		const auto lanes = static_cast<int>(std::min<std::size_t>(4, count - first));
+		for(int lane = 0; lane < 4; ++lane)
+		{
+			if(lane < lanes)
+			{
+				fill(batch, lane, first + std::size_t(lane));
+			}
+			else
+			{
+				clear_lane(batch, lane);
+			}
+		}
+
+		const auto valid = (1u << lanes) - 1u;
+		const auto inside = ~std::uint32_t(outside_mask(planes, batch)) & valid;
+
+		// batches of four never straddle a word
+		visibility[first >> 5] |= inside << (first & 31);
+	}
+}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : test_obbs ()
+/// <summary>
+/// Batched test_obb. Tests 'count' local space boxes, each placed in the
+/// world by the matching transform, four at a time against the frustum
+/// planes. Bit i of 'visibility' ((count + 31) / 32 words) is set when box i
+/// is at least partially inside.
+/// </summary>
+//-----------------------------------------------------------------------------
+void frustum::test_obbs(const bbox* bounds, const affine3x4* transforms, std::size_t count,
+						std::vector<std::uint32_t>& visibility) const
+{
+	test_boxes(planes, count, visibility, [&](box_batch& batch, int lane, std::size_t i) {
+		fill_lane(batch, lane, bounds[i], transforms[i]);
+	});
+}
+
+//-----------------------------------------------------------------------------
+//  Name : test_aabbs ()
+/// <summary>
+/// Batched test_aabb for world space boxes, see test_obbs.
+/// </summary>
+//-----------------------------------------------------------------------------
+void frustum::test_aabbs(const bbox* bounds, std::size_t count, std::vector<std::uint32_t>& visibility) const
+{
+	test_boxes(planes, count, visibility,
+			   [&](box_batch& batch, int lane, std::size_t i) { fill_lane(batch, lane, bounds[i]); });
+}
+
 //-----------------------------------------------------------------------------
 //  Name : testExtrudedOBB ()
 /// <summary>
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "affine3x4.hpp"
 #include "bbox.h"
 #include "bbox_extruded.h"
 #include "math_types.h"
 #include "plane.h"
 #include "transform.h"
 #include <array>
+#include <cstdint>
+#include <vector>
 
 namespace math
 {
@@ -49,6 +52,9 @@ public:
 	bool test_frustum(const frustum& frustum) const;
 	bool test_line(const vec3& v1, const vec3& v2) const;
 	frustum& mul(const transform& t);
+	void test_obbs(const bbox* bounds, const affine3x4* transforms, std::size_t count,
+				   std::vector<std::uint32_t>& visibility) const;
+	void test_aabbs(const bbox* bounds, std::size_t count, std::vector<std::uint32_t>& visibility) const;
 	//-------------------------------------------------------------------------
 	// Public Static Functions
 	//-------------------------------------------------------------------------
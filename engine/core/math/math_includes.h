@@ -1,10 +1,13 @@
 #pragma once
 
+#include "affine3x4.hpp"
 #include "bbox.h"
 #include "bbox_extruded.h"
 #include "bsphere.h"
+#include "bvh.h"
 #include "frustum.h"
 #include "math_types.h"
+#include "occlusion_buffer.h"
 #include "plane.h"
 #include "transform.h"
 #include <cstdint>
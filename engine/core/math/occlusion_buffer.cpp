@@ -0,0 +1,275 @@
+#include "occlusion_buffer.h"
+#include "affine3x4.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace math
+{
+namespace
+{
+/// Vertices closer than this in clip space w are treated as behind the eye.
+const float MIN_W = 1e-4f;
+/// Keeps a box from being hidden by its own surface.
+const float DEPTH_BIAS = 1.0001f;
+
+/// Screen position, y going down, and 1 / w.
+inline vec3 to_screen(const vec4& clip, float width, float height)
+{
+	const float inv_w = 1.0f / clip.w;
+	return {(clip.x * inv_w * 0.5f + 0.5f) * width, (0.5f - clip.y * inv_w * 0.5f) * height, inv_w};
+}
+
+/// Clamps before converting, positions close to the eye plane can be far
+/// outside the int range.
+inline int to_pixel(float v, float limit)
+{
+	return int(std::min(std::max(v, -1.0f), limit));
+}
+
+/// The plane a * x + b * y + c of a value interpolated over the screen.
+struct edge
+{
+	float a;
+	float b;
+	float c;
+
+	inline float at(float x, float y) const
+	{
+		return a * x + b * y + c;
+	}
+};
+
+/// Cross product of 'to' - 'from' with the point relative to 'from'.
+inline edge make_edge(const vec3& from, const vec3& to)
+{
+	edge e;
+	e.a = from.y - to.y;
+	e.b = to.x - from.x;
+	e.c = -(e.a * from.x + e.b * from.y);
+	return e;
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// occlusion_buffer Member Functions
+///////////////////////////////////////////////////////////////////////////////
+//-----------------------------------------------------------------------------
+//  Name : occlusion_buffer () (Constructor)
+/// <summary>
+/// occlusion_buffer Class Constructor
+/// </summary>
+//-----------------------------------------------------------------------------
+occlusion_buffer::occlusion_buffer(std::uint32_t width, std::uint32_t height)
+{
+	resize(width, height);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : resize ()
+/// <summary>
+/// Reallocates the buffer, its content is undefined until the next clear.
+/// </summary>
+//-----------------------------------------------------------------------------
+void occlusion_buffer::resize(std::uint32_t width, std::uint32_t height)
+{
+	width_ = std::max(width, 1u);
+	height_ = std::max(height, 1u);
+	pitch_ = (width_ + 3u) & ~3u;
+	storage_.resize(std::size_t(pitch_) * height_ + 3);
+}
+
+void occlusion_buffer::clear(const transform& view_proj)
+{
+	view_proj_ = view_proj.get_matrix();
+	std::fill(storage_.begin(), storage_.end(), 0.0f);
+}
+
+float* occlusion_buffer::row(std::uint32_t y)
+{
+	auto data = storage_.data();
+	const auto misalignment = (reinterpret_cast<std::uintptr_t>(data) & 15) / sizeof(float);
+	return data + ((4 - misalignment) & 3) + std::size_t(y) * pitch_;
+}
+
+const float* occlusion_buffer::row(std::uint32_t y) const
+{
+	return const_cast<occlusion_buffer*>(this)->row(y);
+}
+
+void occlusion_buffer::draw_triangles(const transform& world, const std::uint8_t* positions,
+									  std::size_t stride, std::size_t vertex_count,
+									  const std::uint32_t* indices, std::size_t index_count)
+{
+	const mat4 world_view_proj = view_proj_ * world.get_matrix();
+
+	clip_.resize(vertex_count);
+	for(std::size_t i = 0; i < vertex_count; ++i)
+	{
+		vec3 position;
+		std::memcpy(&position, positions + i * stride, sizeof(position));
+		clip_[i] = world_view_proj * vec4(position, 1.0f);
+	}
+
+	for(std::size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		draw_triangle(clip_[indices[i]], clip_[indices[i + 1]], clip_[indices[i + 2]]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : draw_triangle () (Private)
+/// <summary>
+/// Half space rasterization of one triangle. The edge functions and 1 / w are
+/// stepped four pixels at a time and only pixel centers inside the triangle
+/// keep the closest depth.
+/// </summary>
+//-----------------------------------------------------------------------------
+void occlusion_buffer::draw_triangle(const vec4& c0, const vec4& c1, const vec4& c2)
+{
+	using namespace detail;
+
+	if(c0.w < MIN_W || c1.w < MIN_W || c2.w < MIN_W)
+	{
+		return;
+	}
+
+	const auto w = float(width_);
+	const auto h = float(height_);
+	const vec3 v0 = to_screen(c0, w, h);
+	const vec3 v1 = to_screen(c1, w, h);
+	const vec3 v2 = to_screen(c2, w, h);
+
+	// Twice the signed area, each edge function is this at the opposite vertex.
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if(std::abs(area) < 1e-6f)
+	{
+		return;
+	}
+
+	// Occluders are rasterized double sided.
+	edge e0 = make_edge(v1, v2);
+	edge e1 = make_edge(v2, v0);
+	edge e2 = make_edge(v0, v1);
+	if(area < 0.0f)
+	{
+		for(auto e : {&e0, &e1, &e2})
+		{
+			e->a = -e->a;
+			e->b = -e->b;
+			e->c = -e->c;
+		}
+		area = -area;
+	}
+
+	const auto min_x = std::max(0, to_pixel(std::floor(std::min({v0.x, v1.x, v2.x})), w));
+	const auto max_x = std::min(int(width_) - 1, to_pixel(std::ceil(std::max({v0.x, v1.x, v2.x})), w));
+	const auto min_y = std::max(0, to_pixel(std::floor(std::min({v0.y, v1.y, v2.y})), h));
+	const auto max_y = std::min(int(height_) - 1, to_pixel(std::ceil(std::max({v0.y, v1.y, v2.y})), h));
+	if(min_x > max_x || min_y > max_y)
+	{
+		return;
+	}
+
+	// 1 / w is the barycentric blend of the vertices, a plane on screen.
+	const float inv_area = 1.0f / area;
+	edge z;
+	z.a = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) * inv_area;
+	z.b = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) * inv_area;
+	z.c = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) * inv_area;
+
+	const int first_x = min_x & ~3;
+	const float x0 = float(first_x) + 0.5f;
+	const float4 lanes = set4(0.0f, 1.0f, 2.0f, 3.0f);
+	auto start = [&lanes, x0](const edge& e, float y) {
+		const float base = e.at(x0, y);
+		return add4(set4(base, base, base, base), mul4(lanes, set4(e.a, e.a, e.a, e.a)));
+	};
+	auto step = [](const edge& e) {
+		const float s = e.a * 4.0f;
+		return set4(s, s, s, s);
+	};
+	const float4 step0 = step(e0);
+	const float4 step1 = step(e1);
+	const float4 step2 = step(e2);
+	const float4 step_z = step(z);
+
+	for(int y = min_y; y <= max_y; ++y)
+	{
+		const float py = float(y) + 0.5f;
+		float4 w0 = start(e0, py);
+		float4 w1 = start(e1, py);
+		float4 w2 = start(e2, py);
+		float4 depth = start(z, py);
+
+		float* dst = row(std::uint32_t(y));
+		for(int x = first_x; x <= max_x; x += 4)
+		{
+			const float4 inside = min4(min4(w0, w1), w2);
+			store4(dst + x, max4(load4(dst + x), keep_ge_zero4(inside, depth)));
+
+			w0 = add4(w0, step0);
+			w1 = add4(w1, step1);
+			w2 = add4(w2, step2);
+			depth = add4(depth, step_z);
+		}
+	}
+}
+
+bool occlusion_buffer::is_occluded(const bbox& bounds) const
+{
+	using namespace detail;
+
+	float min_x = std::numeric_limits<float>::max();
+	float min_y = std::numeric_limits<float>::max();
+	float max_x = -std::numeric_limits<float>::max();
+	float max_y = -std::numeric_limits<float>::max();
+	float closest = 0.0f;
+
+	const auto w = float(width_);
+	const auto h = float(height_);
+	for(int i = 0; i < 8; ++i)
+	{
+		const vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y,
+						  (i & 4) ? bounds.max.z : bounds.min.z);
+		const vec4 clip = view_proj_ * vec4(corner, 1.0f);
+		if(clip.w < MIN_W)
+		{
+			return false;
+		}
+
+		const vec3 screen = to_screen(clip, w, h);
+		min_x = std::min(min_x, screen.x);
+		min_y = std::min(min_y, screen.y);
+		max_x = std::max(max_x, screen.x);
+		max_y = std::max(max_y, screen.y);
+		closest = std::max(closest, screen.z);
+	}
+
+	const auto x_begin = std::max(0, to_pixel(std::floor(min_x), w));
+	const auto x_end = std::min(int(width_) - 1, to_pixel(std::floor(max_x), w));
+	const auto y_begin = std::max(0, to_pixel(std::floor(min_y), h));
+	const auto y_end = std::min(int(height_) - 1, to_pixel(std::floor(max_y), h));
+	if(x_begin > x_end || y_begin > y_end)
+	{
+		return false;
+	}
+
+	// Every covered pixel must hold something closer than the closest corner.
+	const float threshold = closest * DEPTH_BIAS;
+	const float4 box_depth = set4(threshold, threshold, threshold, threshold);
+	for(int y = y_begin; y <= y_end; ++y)
+	{
+		const float* src = row(std::uint32_t(y));
+		for(int x = x_begin & ~3; x <= x_end; x += 4)
+		{
+			if(gt_mask4(load4(src + x), box_depth) != 0xF)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "bbox.h"
+#include "math_types.h"
+#include "transform.h"
+#include <cstdint>
+#include <vector>
+
+namespace math
+{
+using namespace glm;
+
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : occlusion_buffer (Class)
+/// <summary>
+/// Low resolution depth buffer rasterized on the CPU, four pixels at a time.
+/// A few occluder meshes are drawn into it, then bounding boxes are tested
+/// against it so that hidden objects can be skipped before any draw call is
+/// made. Each pixel stores 1 / w, which is linear in screen space and does
+/// not depend on the depth range of the projection. The results are
+/// conservative: a box is only reported occluded when every pixel it covers
+/// holds a closer occluder.
+/// </summary>
+//-----------------------------------------------------------------------------
+class occlusion_buffer
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	occlusion_buffer(std::uint32_t width = 256, std::uint32_t height = 128);
+
+	//-------------------------------------------------------------------------
+	// Public Methods
+	//-------------------------------------------------------------------------
+	void resize(std::uint32_t width, std::uint32_t height);
+
+	//-------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Empties the buffer and sets the view projection used by the following
+	/// draws and tests.
+	/// </summary>
+	//-------------------------------------------------------------------------
+	void clear(const transform& view_proj);
+
+	//-------------------------------------------------------------------------
+	//  Name : draw_triangles ()
+	/// <summary>
+	/// Rasterizes an indexed triangle list. 'positions' points to the first
+	/// vertex position and consecutive positions are 'stride' bytes apart.
+	/// Triangles crossing the near plane are skipped, which only makes the
+	/// occluder smaller.
+	/// </summary>
+	//-------------------------------------------------------------------------
+	void draw_triangles(const transform& world, const std::uint8_t* positions, std::size_t stride,
+						std::size_t vertex_count, const std::uint32_t* indices, std::size_t index_count);
+
+	//-------------------------------------------------------------------------
+	//  Name : is_occluded ()
+	/// <summary>
+	/// True when the world space box is entirely behind what was drawn so far.
+	/// Boxes crossing the near plane or off screen are never occluded.
+	/// </summary>
+	//-------------------------------------------------------------------------
+	bool is_occluded(const bbox& bounds) const;
+
+	inline std::uint32_t get_width() const
+	{
+		return width_;
+	}
+
+	inline std::uint32_t get_height() const
+	{
+		return height_;
+	}
+
+	/// 1 / w of the closest occluder at the pixel, 0 when nothing was drawn
+	inline float get_depth(std::uint32_t x, std::uint32_t y) const
+	{
+		return row(y)[x];
+	}
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Methods
+	//-------------------------------------------------------------------------
+	void draw_triangle(const vec4& c0, const vec4& c1, const vec4& c2);
+	float* row(std::uint32_t y);
+	const float* row(std::uint32_t y) const;
+
+	//-------------------------------------------------------------------------
+	// Private Member Variables
+	//-------------------------------------------------------------------------
+	/// rows of 'pitch_' floats, over allocated so the first one is 16 byte aligned
+	std::vector<float> storage_;
+	/// clip space positions of the mesh being drawn
+	std::vector<vec4> clip_;
+	mat4 view_proj_ = mat4(1.0f);
+	std::uint32_t width_ = 0;
+	std::uint32_t height_ = 0;
+	/// width rounded up to a multiple of 4
+	std::uint32_t pitch_ = 0;
+};
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace memory
+{
+
+//-----------------------------------------------------------------------------
+//  Name : paged_pool (Class)
+/// <summary>
+/// Fixed size block allocator. Blocks are carved out of pages holding
+/// 'blocks_per_page' blocks each, so objects allocated from the same pool end
+/// up packed next to each other in memory. Free blocks are handed out lowest
+/// address first, so once objects get created and destroyed the live ones
+/// stay packed at the front of the pages instead of scattering over them.
+/// Pages are only released when the pool dies. The block size is configured
+/// by the first allocation and never changes after that.
+/// </summary>
+//-----------------------------------------------------------------------------
+class paged_pool
+{
+public:
+    explicit paged_pool(std::size_t blocks_per_page = 256)
+        : blocks_per_page_(std::max<std::size_t>(blocks_per_page, 1))
+    {
+    }
+
+    paged_pool(const paged_pool&) = delete;
+    paged_pool& operator=(const paged_pool&) = delete;
+
+    ~paged_pool()
+    {
+        for(auto page : pages_)
+        {
+            ::operator delete(page);
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : fits ()
+    /// <summary>
+    /// Checks whether a block of the given size and alignment can be served
+    /// by this pool. The first call fixes the block size of the pool. Does
+    /// not lock.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    bool fits(std::size_t size, std::size_t alignment)
+    {
+        if(alignment > alignof(std::max_align_t))
+        {
+            return false;
+        }
+
+        auto block_size = block_size_.load(std::memory_order_acquire);
+        if(block_size == 0)
+        {
+            const auto rounded = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+            // on failure block_size receives the value set by the other thread
+            if(block_size_.compare_exchange_strong(block_size, rounded, std::memory_order_acq_rel))
+            {
+                block_size = rounded;
+            }
+        }
+
+        return size <= block_size;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : allocate ()
+    /// <summary>
+    /// Returns the free block with the lowest address, allocating a new page
+    /// if needed. fits() must have been called before.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(free_blocks_.empty())
+        {
+            grow();
+        }
+
+        std::pop_heap(std::begin(free_blocks_), std::end(free_blocks_), std::greater<unsigned char*>());
+        auto block = free_blocks_.back();
+        free_blocks_.pop_back();
+        ++allocated_blocks_;
+        return block;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : deallocate ()
+    /// <summary>
+    /// Returns a block back to the pool.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void deallocate(void* block)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // never reallocates, grow() reserved room for every block
+        free_blocks_.push_back(static_cast<unsigned char*>(block));
+        std::push_heap(std::begin(free_blocks_), std::end(free_blocks_), std::greater<unsigned char*>());
+        --allocated_blocks_;
+    }
+
+    /// 0 until the first fits(), fixed after that. Does not lock.
+    std::size_t get_block_size() const
+    {
+        return block_size_.load(std::memory_order_acquire);
+    }
+
+    std::size_t get_allocated_blocks() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return allocated_blocks_;
+    }
+
+    std::size_t get_pages_count() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pages_.size();
+    }
+
+private:
+    void grow()
+    {
+        const auto block_size = block_size_.load(std::memory_order_relaxed);
+        auto page = static_cast<unsigned char*>(::operator new(block_size * blocks_per_page_));
+        pages_.push_back(page);
+
+        free_blocks_.reserve(pages_.size() * blocks_per_page_);
+        for(std::size_t i = 0; i < blocks_per_page_; ++i)
+        {
+            free_blocks_.push_back(page + i * block_size);
+            std::push_heap(std::begin(free_blocks_), std::end(free_blocks_), std::greater<unsigned char*>());
+        }
+    }
+
+    /// pages owned by the pool
+    std::vector<unsigned char*> pages_;
+    /// free blocks, a min heap by address
+    std::vector<unsigned char*> free_blocks_;
+    /// size of a single block, set once by the first fits()
+    std::atomic<std::size_t> block_size_{0};
+    /// blocks per single page
+    std::size_t blocks_per_page_ = 256;
+    /// currently allocated blocks
+    std::size_t allocated_blocks_ = 0;
+    /// guards the free blocks as objects can be released from any thread
+    mutable std::mutex mutex_;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : pool_allocator (Class)
+/// <summary>
+/// Standard allocator adapter around a shared paged_pool. Meant to be used
+/// with std::allocate_shared so that the object and its control block share
+/// a single pool block. Each allocator copy keeps the pool alive so objects
+/// can safely outlive whoever created the pool.
+/// </summary>
+//-----------------------------------------------------------------------------
+template<typename T>
+class pool_allocator
+{
+public:
+    using value_type = T;
+
+    explicit pool_allocator(std::shared_ptr<paged_pool> pool) noexcept : pool_(std::move(pool))
+    {
+    }
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U>& other) noexcept : pool_(other.pool_)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if(n == 1 && pool_ && pool_->fits(sizeof(T), alignof(T)))
+        {
+            return static_cast<T*>(pool_->allocate());
+        }
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if(n == 1 && pool_ && alignof(T) <= alignof(std::max_align_t) && sizeof(T) <= pool_->get_block_size())
+        {
+            pool_->deallocate(p);
+            return;
+        }
+
+        ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<U>& rhs) const noexcept
+    {
+        return pool_ == rhs.pool_;
+    }
+
+    template<typename U>
+    bool operator!=(const pool_allocator<U>& rhs) const noexcept
+    {
+        return pool_ != rhs.pool_;
+    }
+
+private:
+    template<typename U>
+    friend class pool_allocator;
+
+    std::shared_ptr<paged_pool> pool_;
+};
+} // namespace memory
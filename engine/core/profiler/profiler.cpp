@@ -0,0 +1,412 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+namespace core
+{
+namespace profiler
+{
+namespace
+{
+/// Records kept per thread, a power of two.
+const std::size_t RING_SIZE = 1 << 14;
+
+//-----------------------------------------------------------------------------
+//  Name : thread_buffer (Struct)
+/// <summary>
+/// Ring of the latest records of one thread. Only the owning thread writes,
+/// it publishes each record by advancing 'written'. Readers copy without
+/// locking and drop what the writer may have overwritten meanwhile.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct thread_buffer
+{
+	void push(const record& r)
+	{
+		const auto index = written.load(std::memory_order_relaxed);
+		records[index & (RING_SIZE - 1)] = r;
+		written.store(index + 1, std::memory_order_release);
+	}
+
+	std::vector<record> records = std::vector<record>(RING_SIZE);
+	std::atomic<std::uint64_t> written = {0};
+	/// open zones, only used by the owning thread
+	std::uint32_t depth = 0;
+	std::uint32_t id = 0;
+	/// guarded by the registry mutex
+	std::string name;
+	/// set when the owning thread exits, it records nothing after that
+	std::atomic<bool> exited = {false};
+};
+
+struct registry
+{
+	std::mutex mutex;
+	/// threads that exit keep their records until the next collect
+	std::vector<std::shared_ptr<thread_buffer>> buffers;
+	std::uint32_t next_id = 1;
+	/// node based, the strings never move
+	std::unordered_set<std::string> names;
+	std::atomic<std::int64_t> frame_begin = {0};
+	std::atomic<std::int64_t> last_frame_begin = {0};
+	std::atomic<std::int64_t> last_frame_end = {0};
+};
+
+registry& get_registry()
+{
+	static registry instance;
+	return instance;
+}
+
+/// The calling thread's buffer, nullptr once its slot is destroyed.
+thread_local thread_buffer* current_buffer = nullptr;
+thread_local bool slot_destroyed = false;
+
+//-----------------------------------------------------------------------------
+//  Name : thread_slot (Struct)
+/// <summary>
+/// Keeps the buffer of a thread alive while it runs and flags it on exit, so
+/// collect can release it once its last records are copied.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct thread_slot
+{
+	~thread_slot()
+	{
+		if(buffer)
+		{
+			buffer->exited.store(true, std::memory_order_release);
+		}
+		current_buffer = nullptr;
+		slot_destroyed = true;
+	}
+
+	std::shared_ptr<thread_buffer> buffer;
+};
+
+/// Returns nullptr while the thread exits, records made then are dropped.
+thread_buffer* get_thread_buffer()
+{
+	if(current_buffer != nullptr || slot_destroyed)
+	{
+		return current_buffer;
+	}
+
+	thread_local thread_slot slot;
+	auto created = std::make_shared<thread_buffer>();
+	auto& reg = get_registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	created->id = reg.next_id++;
+	created->name = "thread " + std::to_string(created->id);
+	reg.buffers.emplace_back(created);
+	slot.buffer = created;
+	current_buffer = created.get();
+	return current_buffer;
+}
+
+void write_escaped(std::ostream& out, const char* str)
+{
+	out << '"';
+	for(; str != nullptr && *str != '\0'; ++str)
+	{
+		const auto c = *str;
+		if(c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if(static_cast<unsigned char>(c) < 0x20)
+		{
+			out << ' ';
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+void write_microseconds(std::ostream& out, std::int64_t ns)
+{
+	out << ns / 1000 << '.';
+	const auto fraction = ns % 1000;
+	out << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction;
+}
+} // namespace
+
+namespace detail
+{
+std::atomic<bool> enabled = {true};
+
+std::int64_t begin_zone()
+{
+	if(auto buffer = get_thread_buffer())
+	{
+		++buffer->depth;
+	}
+	return now();
+}
+
+void end_zone(const char* name, std::int64_t begin)
+{
+	const auto end = now();
+	auto buffer = get_thread_buffer();
+	if(buffer == nullptr)
+	{
+		return;
+	}
+	--buffer->depth;
+
+	record r;
+	r.name = name;
+	r.begin = begin;
+	r.end = end;
+	r.depth = buffer->depth;
+	r.kind = record_kind::zone;
+	buffer->push(r);
+}
+} // namespace detail
+
+void set_enabled(bool enabled)
+{
+	detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::int64_t now()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void set_thread_name(const std::string& name)
+{
+	auto buffer = get_thread_buffer();
+	if(buffer == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(get_registry().mutex);
+	buffer->name = name;
+}
+
+const char* intern(const std::string& name)
+{
+	auto& reg = get_registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return reg.names.emplace(name).first->c_str();
+}
+
+void counter(const char* name, double value)
+{
+	if(!is_enabled())
+	{
+		return;
+	}
+
+	auto buffer = get_thread_buffer();
+	if(buffer == nullptr)
+	{
+		return;
+	}
+
+	record r;
+	r.name = name;
+	r.begin = r.end = now();
+	r.value = value;
+	r.depth = buffer->depth;
+	r.kind = record_kind::counter;
+	buffer->push(r);
+}
+
+void mark_frame()
+{
+	const auto time = now();
+	auto& reg = get_registry();
+	const auto previous = reg.frame_begin.exchange(time, std::memory_order_relaxed);
+	if(previous != 0)
+	{
+		reg.last_frame_begin.store(previous, std::memory_order_relaxed);
+		reg.last_frame_end.store(time, std::memory_order_release);
+	}
+
+	if(!is_enabled())
+	{
+		return;
+	}
+
+	record r;
+	r.name = "frame";
+	r.begin = r.end = time;
+	r.kind = record_kind::frame;
+	if(auto buffer = get_thread_buffer())
+	{
+		buffer->push(r);
+	}
+}
+
+frame_span get_last_frame()
+{
+	auto& reg = get_registry();
+	frame_span span;
+	span.end = reg.last_frame_end.load(std::memory_order_acquire);
+	span.begin = reg.last_frame_begin.load(std::memory_order_relaxed);
+	return span;
+}
+
+capture collect(std::int64_t since)
+{
+	std::vector<std::shared_ptr<thread_buffer>> buffers;
+	std::vector<std::shared_ptr<thread_buffer>> exited;
+	capture cap;
+	auto& reg = get_registry();
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		buffers = reg.buffers;
+		for(const auto& buffer : buffers)
+		{
+			thread_capture thread;
+			thread.id = buffer->id;
+			thread.name = buffer->name;
+			cap.threads.emplace_back(std::move(thread));
+
+			// Nothing is written to them anymore, they go once copied.
+			if(buffer->exited.load(std::memory_order_acquire))
+			{
+				exited.emplace_back(buffer);
+			}
+		}
+	}
+
+	for(std::size_t i = 0; i < buffers.size(); ++i)
+	{
+		const auto& buffer = *buffers[i];
+		auto& records = cap.threads[i].records;
+
+		// Records end in the order they are written, walk back from the newest.
+		const auto written = buffer.written.load(std::memory_order_acquire);
+		const auto oldest = written > RING_SIZE ? written - RING_SIZE : 0;
+		auto first = written;
+		while(first > oldest)
+		{
+			const auto& r = buffer.records[(first - 1) & (RING_SIZE - 1)];
+			if(r.end < since)
+			{
+				break;
+			}
+			records.emplace_back(r);
+			--first;
+		}
+		std::reverse(std::begin(records), std::end(records));
+
+		// Whatever the writer reached while copying may be torn.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// The slot of record 'rewritten' may be half written already.
+		const auto rewritten = buffer.written.load(std::memory_order_relaxed);
+		const auto valid = rewritten + 1 > RING_SIZE ? rewritten + 1 - RING_SIZE : 0;
+		if(valid > first)
+		{
+			const auto torn = std::min<std::uint64_t>(valid - first, records.size());
+			records.erase(std::begin(records), std::begin(records) + std::ptrdiff_t(torn));
+		}
+	}
+
+	if(!exited.empty())
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		reg.buffers.erase(std::remove_if(std::begin(reg.buffers), std::end(reg.buffers),
+										 [&exited](const std::shared_ptr<thread_buffer>& buffer) {
+											 return std::find(std::begin(exited), std::end(exited), buffer) !=
+													std::end(exited);
+										 }),
+						  std::end(reg.buffers));
+	}
+
+	return cap;
+}
+
+std::string to_chrome_trace(const capture& cap)
+{
+	// Timestamps start at the oldest record to keep them short.
+	std::int64_t origin = std::numeric_limits<std::int64_t>::max();
+	for(const auto& thread : cap.threads)
+	{
+		for(const auto& r : thread.records)
+		{
+			origin = std::min(origin, r.begin);
+		}
+	}
+
+	std::ostringstream out;
+	out.imbue(std::locale::classic());
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	auto begin_event = [&out, &first](const char* name, const char* phase, std::uint32_t tid) {
+		out << (first ? "\n" : ",\n") << "{\"name\":";
+		write_escaped(out, name);
+		out << ",\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":" << tid;
+		first = false;
+	};
+
+	for(const auto& thread : cap.threads)
+	{
+		begin_event("thread_name", "M", thread.id);
+		out << ",\"args\":{\"name\":";
+		write_escaped(out, thread.name.c_str());
+		out << "}}";
+
+		for(const auto& r : thread.records)
+		{
+			switch(r.kind)
+			{
+				case record_kind::zone:
+					begin_event(r.name, "X", thread.id);
+					out << ",\"ts\":";
+					write_microseconds(out, r.begin - origin);
+					out << ",\"dur\":";
+					write_microseconds(out, r.end - r.begin);
+					out << "}";
+					break;
+				case record_kind::counter:
+					begin_event(r.name, "C", thread.id);
+					out << ",\"ts\":";
+					write_microseconds(out, r.begin - origin);
+					out << ",\"args\":{\"value\":" << (std::isfinite(r.value) ? r.value : 0.0) << "}}";
+					break;
+				case record_kind::frame:
+					begin_event(r.name, "i", thread.id);
+					out << ",\"s\":\"g\",\"ts\":";
+					write_microseconds(out, r.begin - origin);
+					out << "}";
+					break;
+			}
+		}
+	}
+
+	out << "\n]}\n";
+	return out.str();
+}
+
+bool save_chrome_trace(const capture& cap, const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary);
+	if(!file)
+	{
+		return false;
+	}
+
+	file << to_chrome_trace(cap);
+	return bool(file);
+}
+} // namespace profiler
+} // namespace core
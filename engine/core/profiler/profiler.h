@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace profiler
+{
+//-----------------------------------------------------------------------------
+// Main Declarations
+//-----------------------------------------------------------------------------
+enum class record_kind : std::uint8_t
+{
+	zone,
+	counter,
+	frame,
+};
+
+//-----------------------------------------------------------------------------
+//  Name : record (Struct)
+/// <summary>
+/// One entry of a thread's buffer. Times are steady clock nanoseconds. Names
+/// are not copied, they must outlive every capture that holds them, string
+/// literals are the usual choice.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct record
+{
+	const char* name = nullptr;
+	std::int64_t begin = 0;
+	/// equals begin for counters and frames
+	std::int64_t end = 0;
+	/// counter value
+	double value = 0.0;
+	/// number of zones the zone is nested in
+	std::uint32_t depth = 0;
+	record_kind kind = record_kind::zone;
+};
+
+struct thread_capture
+{
+	/// registration order of the thread, starting at 1
+	std::uint32_t id = 0;
+	std::string name;
+	/// oldest first, zones are ordered by their end
+	std::vector<record> records;
+};
+
+struct capture
+{
+	std::vector<thread_capture> threads;
+};
+
+struct frame_span
+{
+	std::int64_t begin = 0;
+	std::int64_t end = 0;
+};
+
+namespace detail
+{
+extern std::atomic<bool> enabled;
+
+std::int64_t begin_zone();
+void end_zone(const char* name, std::int64_t begin);
+} // namespace detail
+
+//-----------------------------------------------------------------------------
+//  Name : set_enabled ()
+/// <summary>
+/// Recording is on by default. While disabled, zones and counters cost one
+/// relaxed load.
+/// </summary>
+//-----------------------------------------------------------------------------
+void set_enabled(bool enabled);
+
+inline bool is_enabled()
+{
+	return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/// steady clock nanoseconds, the time base of the records
+std::int64_t now();
+
+//-----------------------------------------------------------------------------
+//  Name : set_thread_name ()
+/// <summary>
+/// Names the calling thread in captures.
+/// </summary>
+//-----------------------------------------------------------------------------
+void set_thread_name(const std::string& name);
+
+//-----------------------------------------------------------------------------
+//  Name : intern ()
+/// <summary>
+/// Returns a copy of 'name' that lives until the program exits, for zone and
+/// counter names built at runtime. Equal names share the same copy.
+/// </summary>
+//-----------------------------------------------------------------------------
+const char* intern(const std::string& name);
+
+//-----------------------------------------------------------------------------
+//  Name : counter ()
+/// <summary>
+/// Records a named value, shown as a graph in trace viewers.
+/// </summary>
+//-----------------------------------------------------------------------------
+void counter(const char* name, double value);
+
+//-----------------------------------------------------------------------------
+//  Name : mark_frame ()
+/// <summary>
+/// Marks the start of a frame, called once per frame by the application.
+/// </summary>
+//-----------------------------------------------------------------------------
+void mark_frame();
+
+/// the last frame whose end was marked, empty before the second mark
+frame_span get_last_frame();
+
+//-----------------------------------------------------------------------------
+//  Name : collect ()
+/// <summary>
+/// Copies the records of every thread that ended at or after 'since'. Each
+/// thread keeps its latest records in a fixed size ring, older ones are
+/// overwritten. Safe to call while the other threads keep recording.
+/// Threads that exited are in one capture, then their records are released.
+/// </summary>
+//-----------------------------------------------------------------------------
+capture collect(std::int64_t since = 0);
+
+//-----------------------------------------------------------------------------
+//  Name : to_chrome_trace ()
+/// <summary>
+/// Formats a capture as Chrome trace event JSON, as loaded by
+/// chrome://tracing or Perfetto.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::string to_chrome_trace(const capture& cap);
+bool save_chrome_trace(const capture& cap, const std::string& path);
+
+//-----------------------------------------------------------------------------
+//  Name : scoped_zone (Class)
+/// <summary>
+/// Times its own lifetime. Zones opened while another one is alive on the
+/// same thread are nested in it.
+/// </summary>
+//-----------------------------------------------------------------------------
+class scoped_zone
+{
+public:
+	explicit scoped_zone(const char* name)
+		: name_(name)
+	{
+		if(is_enabled())
+		{
+			begin_ = detail::begin_zone();
+			active_ = true;
+		}
+	}
+
+	~scoped_zone()
+	{
+		if(active_)
+		{
+			detail::end_zone(name_, begin_);
+		}
+	}
+
+	scoped_zone(const scoped_zone&) = delete;
+	scoped_zone& operator=(const scoped_zone&) = delete;
+
+private:
+	const char* name_ = nullptr;
+	std::int64_t begin_ = 0;
+	bool active_ = false;
+};
+} // namespace profiler
+} // namespace core
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#define PROFILE_SCOPE(name) ::core::profiler::scoped_zone PROFILER_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
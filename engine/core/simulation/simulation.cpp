@@ -96,6 +96,24 @@ void simulation::run_one_frame(bool is_active)
         timestep_ = elapsed;
     }
 
+    fixed_step_index_ += fixed_steps_;
+    if(is_fixed_timestep())
+    {
+        // Smoothing would make the number of fixed steps drift from real time.
+        accumulator_ += elapsed;
+        const auto steps = static_cast<std::uint64_t>(accumulator_ / fixed_timestep_);
+        fixed_steps_ = static_cast<std::uint32_t>(std::min<std::uint64_t>(steps, max_fixed_steps_));
+        accumulator_ -= fixed_timestep_ * fixed_steps_;
+
+        // Drop what the cap did not let us catch up with.
+        accumulator_ = accumulator_ % fixed_timestep_;
+    }
+    else
+    {
+        accumulator_ = duration_t::zero();
+        fixed_steps_ = 0;
+    }
+
     ++frame_;
 }
 
@@ -135,4 +153,31 @@ std::chrono::duration<float> simulation::get_delta_time() const
     auto dt = std::chrono::duration_cast<std::chrono::duration<float>>(timestep_);
     return dt;
 }
+
+void simulation::set_fixed_timestep(duration_t step)
+{
+    fixed_timestep_ = std::max(step, duration_t::zero());
+    accumulator_ = duration_t::zero();
+}
+
+void simulation::set_max_fixed_steps(std::uint32_t steps)
+{
+    max_fixed_steps_ = std::max<std::uint32_t>(steps, 1);
+}
+
+std::chrono::duration<float> simulation::get_fixed_delta_time() const
+{
+    return std::chrono::duration_cast<std::chrono::duration<float>>(fixed_timestep_);
+}
+
+float simulation::get_interpolation_alpha() const
+{
+    if(!is_fixed_timestep())
+    {
+        return 1.0f;
+    }
+
+    using fseconds = std::chrono::duration<float>;
+    return std::chrono::duration_cast<fseconds>(accumulator_) / std::chrono::duration_cast<fseconds>(fixed_timestep_);
+}
 } // namespace core
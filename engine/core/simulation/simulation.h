@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <vector>
 
 namespace core
@@ -105,6 +106,73 @@ struct simulation
     //-----------------------------------------------------------------------------
     std::chrono::duration<float> get_delta_time() const;
 
+    //-----------------------------------------------------------------------------
+    //  Name : set_fixed_timestep ()
+    /// <summary>
+    /// Enables the fixed step mode when 'step' is not zero. Every frame the
+    /// unsmoothed elapsed time is added to an accumulator and as many whole
+    /// steps as it holds are run, up to the catch-up cap. The variable delta
+    /// time is still computed for the systems that do not opt in.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void set_fixed_timestep(duration_t step);
+
+    //-----------------------------------------------------------------------------
+    //  Name : set_max_fixed_steps ()
+    /// <summary>
+    /// Set how many fixed steps a single frame may run to catch up. The time
+    /// that would need more is dropped, so a spike slows the simulation down
+    /// instead of making the next frames even longer.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void set_max_fixed_steps(std::uint32_t steps);
+
+    inline bool is_fixed_timestep() const
+    {
+        return fixed_timestep_ > duration_t::zero();
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_fixed_delta_time ()
+    /// <summary>
+    /// Returns the fixed step in seconds.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    std::chrono::duration<float> get_fixed_delta_time() const;
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_fixed_steps ()
+    /// <summary>
+    /// Returns how many fixed steps this frame runs, 0 when the fixed step
+    /// mode is disabled.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    inline std::uint32_t get_fixed_steps() const
+    {
+        return fixed_steps_;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_fixed_step_index ()
+    /// <summary>
+    /// Returns how many fixed steps ran before this frame, the i-th step of
+    /// this frame has the index get_fixed_step_index() + i.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    inline std::uint64_t get_fixed_step_index() const
+    {
+        return fixed_step_index_;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_interpolation_alpha ()
+    /// <summary>
+    /// Returns how far in [0, 1) the frame is between the last fixed step and
+    /// the next one. Rendering blends the last two fixed states with it.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    float get_interpolation_alpha() const;
+
 protected:
     /// minimum/maximum frames per second
     std::uint32_t min_fps_ = 0;
@@ -124,5 +192,15 @@ protected:
     timepoint_t last_frame_timepoint_ = clock_t::now();
     /// time point when we launched
     timepoint_t launch_timepoint_ = clock_t::now();
+    /// fixed step, zero when the fixed step mode is disabled
+    duration_t fixed_timestep_ = duration_t::zero();
+    /// elapsed time not consumed by fixed steps yet
+    duration_t accumulator_ = duration_t::zero();
+    /// fixed steps to run this frame
+    std::uint32_t fixed_steps_ = 0;
+    /// catch-up cap for the fixed steps of a single frame
+    std::uint32_t max_fixed_steps_ = 5;
+    /// fixed steps run before this frame
+    std::uint64_t fixed_step_index_ = 0;
 };
 } // namespace core
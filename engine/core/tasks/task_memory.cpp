@@ -0,0 +1,201 @@
+#include "task_memory.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace core
+{
+namespace detail
+{
+namespace
+{
+/// Blocks of 64, 128, 256 and 512 bytes.
+const std::size_t MIN_BLOCK_SIZE = 64;
+const std::size_t SIZE_CLASSES = 4;
+/// Blocks moved between a thread cache and the shared lists at once.
+const std::size_t BATCH_SIZE = 64;
+
+static_assert((MIN_BLOCK_SIZE << (SIZE_CLASSES - 1)) == max_pooled_task_size, "size classes");
+
+struct free_block
+{
+	free_block* next = nullptr;
+};
+
+struct block_list
+{
+	free_block* head = nullptr;
+	std::size_t count = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : shared_lists (Struct)
+/// <summary>
+/// Batches of free blocks handed between the thread caches. Never destroyed,
+/// threads may free blocks while the program exits.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct shared_lists
+{
+	std::mutex mutex;
+	std::vector<block_list> batches[SIZE_CLASSES];
+};
+
+shared_lists& get_shared_lists()
+{
+	static auto lists = new shared_lists();
+	return *lists;
+}
+
+void push_batch(std::size_t size_class, block_list batch)
+{
+	auto& lists = get_shared_lists();
+	std::lock_guard<std::mutex> lock(lists.mutex);
+	lists.batches[size_class].emplace_back(batch);
+}
+
+block_list pop_batch(std::size_t size_class)
+{
+	auto& lists = get_shared_lists();
+	std::lock_guard<std::mutex> lock(lists.mutex);
+	auto& batches = lists.batches[size_class];
+	if(batches.empty())
+	{
+		return {};
+	}
+
+	auto batch = batches.back();
+	batches.pop_back();
+	return batch;
+}
+
+/// Blocks freed by a thread whose cache is gone go to the shared lists.
+thread_local bool cache_destroyed = false;
+
+//-----------------------------------------------------------------------------
+//  Name : thread_cache (Struct)
+/// <summary>
+/// Free blocks of one thread, used without locking. A thread that frees more
+/// than it allocates, like a worker running tasks pushed by the owner thread,
+/// hands batches back to the shared lists.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct thread_cache
+{
+	~thread_cache()
+	{
+		for(std::size_t i = 0; i < SIZE_CLASSES; ++i)
+		{
+			if(lists[i].head != nullptr)
+			{
+				push_batch(i, lists[i]);
+			}
+		}
+		cache_destroyed = true;
+	}
+
+	block_list lists[SIZE_CLASSES];
+};
+
+thread_cache* get_thread_cache()
+{
+	if(cache_destroyed)
+	{
+		return nullptr;
+	}
+
+	thread_local thread_cache cache;
+	return &cache;
+}
+
+std::size_t get_size_class(std::size_t size)
+{
+	std::size_t size_class = 0;
+	while(size_class < SIZE_CLASSES && size > (MIN_BLOCK_SIZE << size_class))
+	{
+		++size_class;
+	}
+	return size_class;
+}
+} // namespace
+
+void* allocate_task_memory(std::size_t size)
+{
+	const auto size_class = get_size_class(size);
+	if(size_class == SIZE_CLASSES)
+	{
+		return ::operator new(size);
+	}
+
+	auto cache = get_thread_cache();
+	if(cache != nullptr)
+	{
+		auto& list = cache->lists[size_class];
+		if(list.head == nullptr)
+		{
+			list = pop_batch(size_class);
+		}
+
+		if(list.head != nullptr)
+		{
+			auto block = list.head;
+			list.head = block->next;
+			--list.count;
+			block->~free_block();
+			return block;
+		}
+	}
+
+	return ::operator new(MIN_BLOCK_SIZE << size_class);
+}
+
+void deallocate_task_memory(void* ptr, std::size_t size) noexcept
+{
+	if(ptr == nullptr)
+	{
+		return;
+	}
+
+	const auto size_class = get_size_class(size);
+	if(size_class == SIZE_CLASSES)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	auto block = ::new(ptr) free_block();
+	auto cache = get_thread_cache();
+	if(cache == nullptr)
+	{
+		block_list single;
+		single.head = block;
+		single.count = 1;
+		push_batch(size_class, single);
+		return;
+	}
+
+	auto& list = cache->lists[size_class];
+	block->next = list.head;
+	list.head = block;
+	++list.count;
+
+	if(list.count >= 2 * BATCH_SIZE)
+	{
+		block_list batch;
+		batch.head = list.head;
+		batch.count = BATCH_SIZE;
+		auto last = list.head;
+		for(std::size_t i = 1; i < BATCH_SIZE; ++i)
+		{
+			last = last->next;
+		}
+
+		list.head = last->next;
+		list.count -= BATCH_SIZE;
+		last->next = nullptr;
+		push_batch(size_class, batch);
+	}
+}
+} // namespace detail
+} // namespace core
@@ -0,0 +1,34 @@
+#ifndef TASK_MEMORY_H
+#define TASK_MEMORY_H
+
+#include <cstddef>
+
+namespace core
+{
+namespace detail
+{
+//-----------------------------------------------------------------------------
+//  Name : allocate_task_memory ()
+/// <summary>
+/// Allocates the memory of a task and its shared state. Blocks of up to
+/// max_pooled_task_size bytes are recycled through a cache on each thread and
+/// a shared list, so pushing tasks does not reach the heap once the pool
+/// has grown to the number of tasks in flight. Larger blocks use the heap.
+/// </summary>
+//-----------------------------------------------------------------------------
+void* allocate_task_memory(std::size_t size);
+
+//-----------------------------------------------------------------------------
+//  Name : deallocate_task_memory ()
+/// <summary>
+/// Recycles a block from allocate_task_memory, 'size' is the size it was
+/// allocated with. Any thread may free a block.
+/// </summary>
+//-----------------------------------------------------------------------------
+void deallocate_task_memory(void* ptr, std::size_t size) noexcept;
+
+constexpr std::size_t max_pooled_task_size = 512;
+} // namespace detail
+} // namespace core
+
+#endif // #ifndef TASK_MEMORY_H
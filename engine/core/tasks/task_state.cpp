@@ -0,0 +1,149 @@
+#include "task_state.h"
+#include "task_memory.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace core
+{
+namespace detail
+{
+namespace
+{
+/// States hashed to the same stripe share its mutex and condition.
+const std::size_t WAIT_STRIPES = 32;
+
+struct wait_stripe
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+};
+
+wait_stripe& get_wait_stripe(const void* state)
+{
+	// Never destroyed, threads may still wait while the program exits.
+	static auto stripes = new wait_stripe[WAIT_STRIPES];
+	return stripes[(reinterpret_cast<std::uintptr_t>(state) / 64) % WAIT_STRIPES];
+}
+} // namespace
+
+task_state::continuation* task_state::completed_tag()
+{
+	static continuation tag;
+	return &tag;
+}
+
+task_state::task_state() noexcept
+{
+	static std::atomic<std::uint64_t> id = {1};
+	id_ = id.fetch_add(1, std::memory_order_relaxed);
+}
+
+task_state::~task_state()
+{
+	auto node = continuations_.load(std::memory_order_acquire);
+	while(node != nullptr && node != completed_tag())
+	{
+		auto next = node->next;
+		node->~continuation();
+		deallocate_task_memory(node, sizeof(continuation));
+		node = next;
+	}
+}
+
+bool task_state::when_ready_(task_system& /*unused*/, std::size_t /*unused*/)
+{
+	return false;
+}
+
+void task_state::wait() const
+{
+	if(is_ready())
+	{
+		return;
+	}
+
+	auto& stripe = get_wait_stripe(this);
+	std::unique_lock<std::mutex> lock(stripe.mutex);
+	// Announced under the lock, so set_ready either sees it or is seen here.
+	status_.fetch_or(waiters_bit, std::memory_order_acq_rel);
+	stripe.cv.wait(lock, [this]() { return is_ready(); });
+}
+
+bool task_state::wait_until(std::chrono::steady_clock::time_point abs_time) const
+{
+	if(is_ready())
+	{
+		return true;
+	}
+
+	if(std::chrono::steady_clock::now() >= abs_time)
+	{
+		return false;
+	}
+
+	auto& stripe = get_wait_stripe(this);
+	std::unique_lock<std::mutex> lock(stripe.mutex);
+	status_.fetch_or(waiters_bit, std::memory_order_acq_rel);
+	return stripe.cv.wait_until(lock, abs_time, [this]() { return is_ready(); });
+}
+
+void task_state::then(task_continuation f)
+{
+	auto node = ::new(allocate_task_memory(sizeof(continuation))) continuation();
+	node->f = std::move(f);
+	node->next = continuations_.load(std::memory_order_acquire);
+	while(node->next != completed_tag())
+	{
+		if(continuations_.compare_exchange_weak(node->next, node, std::memory_order_release,
+												std::memory_order_acquire))
+		{
+			return;
+		}
+	}
+
+	auto ready = std::move(node->f);
+	node->~continuation();
+	deallocate_task_memory(node, sizeof(continuation));
+	ready();
+}
+
+void task_state::set_ready() noexcept
+{
+	const auto status = status_.fetch_or(ready_bit, std::memory_order_acq_rel);
+	if(status & waiters_bit)
+	{
+		auto& stripe = get_wait_stripe(this);
+		{
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+		}
+		stripe.cv.notify_all();
+	}
+
+	auto head = continuations_.exchange(completed_tag(), std::memory_order_acq_rel);
+	if(head == completed_tag())
+	{
+		return;
+	}
+
+	// Pushed last first, run them in registration order.
+	continuation* ordered = nullptr;
+	while(head != nullptr)
+	{
+		auto next = head->next;
+		head->next = ordered;
+		ordered = head;
+		head = next;
+	}
+
+	while(ordered != nullptr)
+	{
+		auto node = ordered;
+		ordered = node->next;
+		node->f();
+		node->~continuation();
+		deallocate_task_memory(node, sizeof(continuation));
+	}
+}
+} // namespace detail
+} // namespace core
@@ -0,0 +1,215 @@
+#ifndef TASK_STATE_H
+#define TASK_STATE_H
+
+#include "../common/hpp/inplace_function.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace core
+{
+class task_system;
+
+/// Stored inline in pooled nodes, a std::function fits.
+using task_continuation = hpp::inplace_function<void(), 48>;
+
+namespace detail
+{
+//-----------------------------------------------------------------------------
+//  Name : task_state (Class)
+/// <summary>
+/// What a task shares with its futures: the callable and its arguments until
+/// it runs, then its result. The task holds one reference and every future
+/// one more, the last release returns the state to the task memory pool.
+/// Continuations registered before the state is ready run on the thread that
+/// makes it ready, right after it. Later ones run immediately.
+/// </summary>
+//-----------------------------------------------------------------------------
+class task_state
+{
+public:
+	task_state() noexcept;
+	task_state(const task_state&) = delete;
+	task_state& operator=(const task_state&) = delete;
+
+	void add_ref() noexcept
+	{
+		refs_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void release() noexcept
+	{
+		if(refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			destroy_();
+		}
+	}
+
+	/// runs the callable, once, and makes the state ready
+	virtual void invoke_() = 0;
+	/// false while some future arguments are not ready
+	virtual bool ready_() const noexcept = 0;
+	/// destroys a callable that never ran, the futures get a broken promise
+	virtual void discard_() noexcept = 0;
+
+	//-----------------------------------------------------------------------------
+	//  Name : when_ready_ ()
+	/// <summary>
+	/// Pushes the task with on_inputs_ready once its future arguments are
+	/// ready, taking over the task's reference. Returns false and does nothing
+	/// when one of them can not notify.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	virtual bool when_ready_(task_system& system, std::size_t idx);
+
+	bool is_ready() const noexcept
+	{
+		return (status_.load(std::memory_order_acquire) & ready_bit) != 0;
+	}
+
+	void wait() const;
+	/// returns whether the state is ready
+	bool wait_until(std::chrono::steady_clock::time_point abs_time) const;
+
+	void then(task_continuation f);
+
+	std::uint64_t get_id() const noexcept
+	{
+		return id_;
+	}
+
+protected:
+	virtual ~task_state();
+
+	/// destroys the state and frees its memory
+	virtual void destroy_() noexcept = 0;
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_ready ()
+	/// <summary>
+	/// Publishes the result or the exception, wakes the waiting threads up and
+	/// runs the continuations.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_ready() noexcept;
+
+	void set_exception(std::exception_ptr error) noexcept
+	{
+		error_ = std::move(error);
+	}
+
+	void rethrow_if_failed() const
+	{
+		if(error_)
+		{
+			std::rethrow_exception(error_);
+		}
+	}
+
+private:
+	enum : std::uint32_t
+	{
+		ready_bit = 1,
+		waiters_bit = 2,
+	};
+
+	struct continuation
+	{
+		task_continuation f;
+		continuation* next = nullptr;
+	};
+
+	static continuation* completed_tag();
+
+	std::atomic<std::uint32_t> refs_{1};
+	mutable std::atomic<std::uint32_t> status_{0};
+	/// lock-free stack of the pending continuations, or completed_tag()
+	std::atomic<continuation*> continuations_{nullptr};
+	std::exception_ptr error_;
+	std::uint64_t id_ = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : task_result (Class)
+/// <summary>
+/// A task_state holding a result of type R.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename R>
+class task_result : public task_state
+{
+public:
+	const R& get() const
+	{
+		rethrow_if_failed();
+		return *reinterpret_cast<const R*>(&storage_);
+	}
+
+protected:
+	~task_result() override
+	{
+		if(has_value_)
+		{
+			reinterpret_cast<R*>(&storage_)->~R();
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args)
+	{
+		::new(&storage_) R(std::forward<Args>(args)...);
+		has_value_ = true;
+	}
+
+private:
+	std::aligned_storage_t<sizeof(R), alignof(R)> storage_;
+	bool has_value_ = false;
+};
+
+template <typename R>
+class task_result<R&> : public task_state
+{
+public:
+	R& get() const
+	{
+		rethrow_if_failed();
+		return *value_;
+	}
+
+protected:
+	void set_value(R& value)
+	{
+		value_ = std::addressof(value);
+	}
+
+private:
+	R* value_ = nullptr;
+};
+
+template <>
+class task_result<void> : public task_state
+{
+public:
+	void get() const
+	{
+		rethrow_if_failed();
+	}
+};
+
+//-----------------------------------------------------------------------------
+//  Name : on_inputs_ready ()
+/// <summary>
+/// Pushes a task whose future arguments became ready to the thread 'idx' of
+/// the system, see task_state::when_ready_.
+/// </summary>
+//-----------------------------------------------------------------------------
+void on_inputs_ready(task_system& system, task_state* state, std::size_t idx);
+} // namespace detail
+} // namespace core
+
+#endif // #ifndef TASK_STATE_H
@@ -1,42 +1,104 @@
 #include "task_system.h"
 #include "../common/platform/thread.hpp"
+#include "../profiler/profiler.h"
+#include <string>
 #include <limits>
 
 namespace core
 {
+namespace
+{
+/// The task system and thread index of the calling worker thread.
+struct worker_context
+{
+	const task_system* system = nullptr;
+	std::size_t idx = 0;
+};
 
-task::task_concept::~task_concept() noexcept = default;
+thread_local worker_context current_worker;
+} // namespace
 
-task::task_concept::task_concept() noexcept
+void task_system::task_queue::requeue_front()
 {
-	static std::atomic<std::uint64_t> id = {1};
-	id_ = id++;
+	// Only tasks waiting on futures that can not notify get here.
+	if(tasks_.size() - head_ > 1)
+	{
+		push_back(pop_front());
+	}
 }
 
-void task_system::task_queue::sort()
+void task_system::task_queue::push_back(task t)
 {
-	if(tasks_.size() > 1)
+	if(head_ == tasks_.size())
 	{
-		std::stable_partition(tasks_.begin(), tasks_.end(), [](const auto& task1) { return task1.ready(); });
+		tasks_.clear();
+		head_ = 0;
 	}
+	else if(tasks_.size() == tasks_.capacity() && head_ >= tasks_.size() / 2)
+	{
+		// Reuses the slots of the popped tasks instead of growing.
+		tasks_.erase(std::begin(tasks_), std::begin(tasks_) + std::ptrdiff_t(head_));
+		head_ = 0;
+	}
+
+	tasks_.emplace_back(std::move(t));
+	size_.store(tasks_.size() - head_, std::memory_order_relaxed);
+}
+
+task task_system::task_queue::pop_front()
+{
+	auto t = std::move(tasks_[head_++]);
+	if(head_ == tasks_.size())
+	{
+		// Keeps the capacity, a steady flow of tasks does not allocate.
+		tasks_.clear();
+		head_ = 0;
+	}
+
+	size_.store(tasks_.size() - head_, std::memory_order_relaxed);
+	return t;
 }
 
 task_system::task_queue::task_queue(task_system::task_queue&& other) noexcept
 	: tasks_(std::move(other.tasks_))
+	, head_(other.head_)
 	, done_(other.done_.load())
+	, size_(tasks_.size() - head_)
 {
 }
 
 std::size_t task_system::task_queue::get_pending_tasks() const
 {
 	std::lock_guard<std::mutex> lock(mutex_);
-	return tasks_.size();
+	return tasks_.size() - head_;
+}
+
+bool task_system::task_queue::has_ready_tasks() const
+{
+	if(is_empty())
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return std::any_of(std::begin(tasks_) + std::ptrdiff_t(head_), std::end(tasks_),
+					   [](const auto& t) { return t.ready(); });
+}
+
+bool task_system::task_queue::is_empty() const
+{
+	return size_.load(std::memory_order_relaxed) == 0;
 }
 
 void task_system::task_queue::clear()
 {
+	// Dropped tasks run their continuations, which may push here.
+	std::vector<task> dropped;
 	std::unique_lock<std::mutex> lock(mutex_);
-	tasks_.clear();
+	dropped.swap(tasks_);
+	head_ = 0;
+	size_.store(0, std::memory_order_relaxed);
+	lock.unlock();
 }
 
 void task_system::task_queue::set_done()
@@ -54,18 +116,16 @@ std::pair<bool, task> task_system::task_queue::try_pop()
 {
 	std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
 
-	if(!lock || tasks_.empty())
+	if(!lock || head_ == tasks_.size())
 	{
 		return std::make_pair(false, task{});
 	}
-	if(tasks_.front().ready())
+	if(tasks_[head_].ready())
 	{
-		auto t = std::move(tasks_.front());
-		tasks_.pop_front();
-		return std::make_pair(true, std::move(t));
+		return std::make_pair(true, pop_front());
 	}
 
-	sort();
+	requeue_front();
 	return std::make_pair(false, task{});
 }
 
@@ -78,7 +138,7 @@ bool task_system::task_queue::try_push(task& t)
 			return false;
 		}
 
-		tasks_.emplace_back(std::move(t));
+		push_back(std::move(t));
 	}
 
 	cv_.notify_one();
@@ -90,7 +150,7 @@ std::pair<bool, task> task_system::task_queue::pop(duration_t pop_timeout)
 	std::unique_lock<std::mutex> lock(mutex_);
 	bool wait = pop_timeout > duration_t(0);
 	bool timed_wait = pop_timeout != duration_t::max();
-	if(wait && tasks_.empty())
+	if(wait && head_ == tasks_.size())
 	{
 		if(timed_wait)
 		{
@@ -102,28 +162,17 @@ std::pair<bool, task> task_system::task_queue::pop(duration_t pop_timeout)
 		}
 	}
 
-	if(tasks_.empty())
+	if(head_ == tasks_.size())
 	{
 		return std::make_pair(false, task{});
 	}
 
-	if(tasks_.front().ready())
+	if(tasks_[head_].ready())
 	{
-		auto t = std::move(tasks_.front());
-		tasks_.pop_front();
-		return std::make_pair(true, std::move(t));
-	}
-
-	sort();
-
-	// try after sort
-	if(tasks_.front().ready())
-	{
-		auto t = std::move(tasks_.front());
-		tasks_.pop_front();
-		return std::make_pair(true, std::move(t));
+		return std::make_pair(true, pop_front());
 	}
 
+	requeue_front();
 	return std::make_pair(false, task{});
 }
 
@@ -131,7 +180,7 @@ void task_system::task_queue::push(task t)
 {
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		tasks_.emplace_back(std::move(t));
+		push_back(std::move(t));
 	}
 	cv_.notify_one();
 }
@@ -143,66 +192,379 @@ void task_system::task_queue::wake_up()
 
 bool task_system::task_queue::cancel(uint64_t id)
 {
-	bool res = false;
+	// Destroyed outside the lock, it runs the continuations of the task.
+	task cancelled;
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		tasks_.erase(std::remove_if(std::begin(tasks_), std::end(tasks_),
-									[id, &res](const auto& task) {
-										auto cmp = task.get_id() == id;
-										if(cmp)
-										{
-											res = true;
-										}
-										return cmp;
-									}),
-					 std::end(tasks_));
+		auto it = std::find_if(std::begin(tasks_) + std::ptrdiff_t(head_), std::end(tasks_),
+							   [id](const auto& task) { return task.get_id() == id; });
+		if(it != std::end(tasks_))
+		{
+			cancelled = std::move(*it);
+			tasks_.erase(it);
+			size_.store(tasks_.size() - head_, std::memory_order_relaxed);
+		}
 	}
 	cv_.notify_one();
 
-	return res;
+	return bool(cancelled);
 }
 
 void task_system::run(std::size_t idx, const std::function<bool()>& condition, duration_t pop_timeout)
 {
+	const auto queue_index = get_thread_queue_idx(idx);
+	auto& queue = queues_[queue_index];
+	const bool is_worker = queue_index != get_owner_thread_idx();
+
 	while(condition())
 	{
-		const auto queue_index = get_thread_queue_idx(idx);
-		bool is_done = queues_[queue_index].is_done();
-		bool is_empty = queues_[queue_index].get_pending_tasks() == 0;
-		if(is_done && is_empty)
+		if(queue.is_done())
 		{
-			return;
+			const bool is_empty = queue.get_pending_tasks() == 0 &&
+								  (!is_worker || (deques_[queue_index]->empty() &&
+												  shared_queues_[compute_critical_queue].is_empty() &&
+												  shared_queues_[compute_background_queue].is_empty()));
+			if(is_empty || !wait_on_destruct_)
+			{
+				return;
+			}
+		}
+
+		// The owner thread only runs what was pushed on it.
+		task t;
+		if(is_worker)
+		{
+			t = find_work(queue_index);
+		}
+		else
+		{
+			auto p = queue.pop(pop_timeout);
+			if(p.first)
+			{
+				t = std::move(p.second);
+			}
+		}
+
+		if(t)
+		{
+			PROFILE_SCOPE("task");
+			t();
+		}
+		else if(is_worker)
+		{
+			park(queue_index, pop_timeout);
+		}
+	}
+}
+
+task task_system::find_work(std::size_t idx, bool allow_background)
+{
+	if(auto t = pop_shared(compute_critical_queue))
+	{
+		return t;
+	}
+
+	if(auto raw = deques_[idx]->pop())
+	{
+		return task(raw);
+	}
+
+	auto p = queues_[idx].try_pop();
+	if(p.first)
+	{
+		return std::move(p.second);
+	}
+
+	if(auto t = steal_work(idx))
+	{
+		return t;
+	}
+
+	if(!allow_background)
+	{
+		return task();
+	}
+
+	return pop_shared(compute_background_queue);
+}
+
+task task_system::steal_work(std::size_t idx)
+{
+	// Start at a different victim each time so thieves spread out.
+	thread_local std::size_t seed = 0;
+	const auto workers = threads_count_ - 1;
+	const auto start = seed++;
+	for(std::size_t k = 0; k < workers; ++k)
+	{
+		const auto victim = 1 + (start + k) % workers;
+		if(victim == idx)
+		{
+			continue;
 		}
 
-		std::pair<bool, task> p = {false, task()};
+		if(auto raw = deques_[victim]->steal())
+		{
+			return task(raw);
+		}
 
-		if(idx != 0 && is_empty)
+		auto p = queues_[victim].try_pop();
+		if(p.first)
+		{
+			return std::move(p.second);
+		}
+	}
+
+	return task();
+}
+
+void task_system::help_while(const std::function<bool()>& condition, bool allow_background)
+{
+	const auto& worker = current_worker;
+	const bool is_worker = worker.system == this;
+	const bool is_owner = std::this_thread::get_id() == owner_thread_id_;
+	while(condition())
+	{
+		task t;
+		if(is_worker)
 		{
-			std::size_t steal_attempts = threads_count_;
-			const auto queue_idx = get_most_free_queue_idx(true);
-			for(std::size_t k = 0; k < steal_attempts; ++k)
+			t = find_work(worker.idx, allow_background);
+		}
+		else
+		{
+			// Background tasks may take long, they are left to the workers.
+			t = pop_shared(compute_critical_queue);
+			if(!t)
+			{
+				t = steal_work(get_owner_thread_idx());
+			}
+			if(!t && is_owner)
 			{
-				if(queue_index != queue_idx)
+				auto p = queues_[get_owner_thread_idx()].try_pop();
+				if(p.first)
 				{
-					p = queues_[queue_idx].try_pop();
-					if(p.first)
-					{
-						break;
-					}
+					t = std::move(p.second);
 				}
 			}
 		}
 
-		if(!p.first)
+		if(t)
+		{
+			PROFILE_SCOPE("task");
+			t();
+		}
+		else
 		{
-			p = queues_[queue_index].pop(pop_timeout);
+			// What is left runs on other threads.
+			std::this_thread::yield();
 		}
+	}
+}
 
-		if(p.first)
+bool task_system::has_worker_tasks() const
+{
+	if(shared_queues_[compute_critical_queue].has_ready_tasks() ||
+	   shared_queues_[compute_background_queue].has_ready_tasks())
+	{
+		return true;
+	}
+
+	for(std::size_t i = 1; i < threads_count_; ++i)
+	{
+		if(!deques_[i]->empty() || queues_[i].has_ready_tasks())
 		{
-			p.second();
+			return true;
 		}
 	}
+	return false;
+}
+
+void task_system::park(std::size_t idx, duration_t timeout)
+{
+	std::unique_lock<std::mutex> lock(park_mutex_);
+	parked_.fetch_add(1, std::memory_order_seq_cst);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Announced before looking, so a concurrent push either sees this worker
+	// parked or its task is seen here.
+	if(!queues_[idx].is_done() && !has_worker_tasks())
+	{
+		const auto epoch = wake_epoch_;
+		const auto woken = [this, idx, epoch]() { return wake_epoch_ != epoch || queues_[idx].is_done(); };
+		if(timeout == duration_t::max())
+		{
+			park_cv_.wait(lock, woken);
+		}
+		else
+		{
+			park_cv_.wait_for(lock, timeout, woken);
+		}
+	}
+
+	parked_.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void task_system::wake_up_worker()
+{
+	// Pairs with the announcement in park.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(parked_.load(std::memory_order_seq_cst) == 0)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(park_mutex_);
+		++wake_epoch_;
+	}
+	park_cv_.notify_one();
+}
+
+void task_system::push_ready(task t, std::size_t idx)
+{
+	if(idx == any_worker_idx)
+	{
+		push_on_any_worker(std::move(t));
+		return;
+	}
+
+	if(idx >= shared_queue_idx)
+	{
+		push_shared(std::move(t), idx - shared_queue_idx);
+		return;
+	}
+
+	const auto queue_index = get_thread_queue_idx(idx);
+	queues_[queue_index].push(std::move(t));
+	if(queue_index != get_owner_thread_idx())
+	{
+		wake_up_worker();
+	}
+}
+
+void task_system::push_when_ready(task t, std::size_t idx)
+{
+	auto state = t.release();
+	if(!state->when_ready_(*this, idx))
+	{
+		push_ready(task(state), idx);
+	}
+}
+
+void task_system::push_inputs_ready(detail::task_state* state, std::size_t idx)
+{
+	// Destroying the task breaks its promise.
+	task t(state);
+	if(!stopping_.load())
+	{
+		push_ready(std::move(t), idx);
+	}
+}
+
+void detail::on_inputs_ready(task_system& system, detail::task_state* state, std::size_t idx)
+{
+	system.push_inputs_ready(state, idx);
+}
+
+void task_system::push_on_any_worker(task t)
+{
+	if(threads_count_ == 1)
+	{
+		queues_[get_owner_thread_idx()].push(std::move(t));
+		return;
+	}
+
+	const auto& worker = current_worker;
+	if(worker.system == this && t.ready())
+	{
+		deques_[worker.idx]->push(t.release());
+	}
+	else
+	{
+		queues_[get_any_worker_thread_idx()].push(std::move(t));
+	}
+
+	wake_up_worker();
+}
+
+void task_system::push_shared(task t, std::size_t slot)
+{
+	if(slot >= io_queue)
+	{
+		shared_queues_[slot].push(std::move(t));
+		{
+			// Pairs with the check of the sleeping io threads.
+			std::lock_guard<std::mutex> lock(io_mutex_);
+		}
+		io_cv_.notify_one();
+		return;
+	}
+
+	if(threads_count_ == 1)
+	{
+		queues_[get_owner_thread_idx()].push(std::move(t));
+		return;
+	}
+
+	shared_queues_[slot].push(std::move(t));
+	wake_up_worker();
+}
+
+task task_system::pop_shared(std::size_t slot)
+{
+	auto& queue = shared_queues_[slot];
+	if(queue.is_empty())
+	{
+		return task();
+	}
+
+	auto p = queue.pop(duration_t(0));
+	if(p.first)
+	{
+		return std::move(p.second);
+	}
+
+	return task();
+}
+
+void task_system::run_io()
+{
+	using namespace std::literals;
+	while(true)
+	{
+		task t;
+		for(std::size_t slot = io_queue; slot < shared_queues_count && !t; ++slot)
+		{
+			t = pop_shared(slot);
+		}
+
+		if(t)
+		{
+			PROFILE_SCOPE("io task");
+			t();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(io_mutex_);
+		if(io_done_ && (!wait_on_destruct_ || !has_io_tasks()))
+		{
+			return;
+		}
+
+		// Tasks polling on futures are retried after the timeout.
+		io_cv_.wait_for(lock, 50ms, [this]() { return io_done_ || has_io_tasks(); });
+	}
+}
+
+bool task_system::has_io_tasks() const
+{
+	for(std::size_t slot = io_queue; slot < shared_queues_count; ++slot)
+	{
+		if(shared_queues_[slot].has_ready_tasks())
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 std::size_t task_system::get_thread_queue_idx(std::size_t idx, std::size_t seed)
@@ -237,15 +599,17 @@ task_system::task_system(bool wait_on_destruct)
 {
 }
 
-task_system::task_system(bool wait_on_destruct, std::size_t nthreads)
+task_system::task_system(bool wait_on_destruct, std::size_t nthreads, std::size_t io_threads)
 	: threads_count_{nthreads}
 	, wait_on_destruct_(wait_on_destruct)
 {
 	queues_.reserve(threads_count_);
 	queues_.emplace_back();
+	deques_.emplace_back();
 	for(std::size_t th = 1; th < threads_count_; ++th)
 	{
 		queues_.emplace_back();
+		deques_.emplace_back(std::make_unique<task_deque>());
 	}
 
 	// two seperate loops.
@@ -254,13 +618,33 @@ task_system::task_system(bool wait_on_destruct, std::size_t nthreads)
 	using namespace std::literals;
 	for(std::size_t th = 1; th < threads_count_; ++th)
 	{
-		threads_.emplace_back(&task_system::run, this, th, []() { return true; }, 50ms);
+		threads_.emplace_back([this, th]() {
+			current_worker.system = this;
+			current_worker.idx = th;
+			profiler::set_thread_name("task_worker " + std::to_string(th));
+			run(th, []() { return true; }, 50ms);
+		});
 		platform::set_thread_name(threads_.back(), "task_worker");
 	}
+
+	io_threads_.reserve(io_threads);
+	for(std::size_t th = 0; th < io_threads; ++th)
+	{
+		io_threads_.emplace_back([this, th]() {
+			profiler::set_thread_name("task_io " + std::to_string(th + 1));
+			run_io();
+		});
+		platform::set_thread_name(io_threads_.back(), "task_io");
+	}
 }
 
 task_system::~task_system()
 {
+	if(!wait_on_destruct_)
+	{
+		stopping_.store(true);
+	}
+
 	for(auto& q : queues_)
 	{
 		if(!wait_on_destruct_)
@@ -269,6 +653,25 @@ task_system::~task_system()
 		}
 		q.set_done();
 	}
+	for(auto& q : shared_queues_)
+	{
+		if(!wait_on_destruct_)
+		{
+			q.clear();
+		}
+		q.set_done();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(park_mutex_);
+		++wake_epoch_;
+	}
+	park_cv_.notify_all();
+	{
+		std::lock_guard<std::mutex> lock(io_mutex_);
+		io_done_ = true;
+	}
+	io_cv_.notify_all();
 
 	for(auto& th : threads_)
 	{
@@ -277,6 +680,25 @@ task_system::~task_system()
 			th.join();
 		}
 	}
+	for(auto& th : io_threads_)
+	{
+		th.join();
+	}
+	stopping_.store(true);
+
+	// Whatever is left was not waited for, dropping it breaks its promise.
+	for(auto& deque : deques_)
+	{
+		if(!deque)
+		{
+			continue;
+		}
+
+		while(auto raw = deque->pop())
+		{
+			task dropped(raw);
+		}
+	}
 }
 
 void task_system::run_on_owner_thread(duration_t max_duration)
@@ -297,6 +719,7 @@ void task_system::run_on_owner_thread(duration_t max_duration)
 
 		if(p.first)
 		{
+			PROFILE_SCOPE("owner task");
 			p.second();
 		}
 
@@ -313,8 +736,17 @@ task_system::system_info task_system::get_info() const
 		info.queue_infos.emplace_back();
 		auto& q_info = info.queue_infos.back();
 		q_info.pending_tasks = queue.get_pending_tasks();
+		const auto idx = info.queue_infos.size() - 1;
+		if(deques_[idx])
+		{
+			q_info.pending_tasks += deques_[idx]->size();
+		}
 		info.pending_tasks += q_info.pending_tasks;
 	}
+	for(const auto& queue : shared_queues_)
+	{
+		info.pending_tasks += queue.get_pending_tasks();
+	}
 	return info;
 }
 } // namespace core
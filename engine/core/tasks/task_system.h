@@ -2,18 +2,23 @@
 #define TASK_SYSTEM_H
 
 #include "future_traits.hpp"
+#include "task_memory.h"
+#include "task_state.h"
+#include "work_stealing_deque.hpp"
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <exception>
+#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -21,26 +26,64 @@
 namespace core
 {
 class task_system;
+class task;
 
 template <typename T>
 class task_future
 {
 public:
+	task_future() = default;
+
+	task_future(const task_future& other) noexcept
+		: state_(other.state_)
+		, executor_(other.executor_)
+	{
+		if(state_)
+		{
+			state_->add_ref();
+		}
+	}
+
+	task_future(task_future&& other) noexcept
+		: state_(other.state_)
+		, executor_(other.executor_)
+	{
+		other.state_ = nullptr;
+	}
+
+	task_future& operator=(task_future other) noexcept
+	{
+		std::swap(state_, other.state_);
+		std::swap(executor_, other.executor_);
+		return *this;
+	}
+
+	~task_future()
+	{
+		if(state_)
+		{
+			state_->release();
+		}
+	}
+
 	decltype(auto) get() const
 	{
 		wait();
 
-		return future_.get();
+		if(!state_)
+		{
+			throw std::future_error(std::future_errc::no_state);
+		}
+		return state_->get();
 	}
 
-	decltype(auto) valid() const
+	bool valid() const
 	{
-		return future_.valid();
+		return state_ != nullptr;
 	}
 	bool is_ready() const
 	{
-		using namespace std::chrono_literals;
-		return valid() && wait_for(0s) == std::future_status::ready;
+		return valid() && state_->is_ready();
 	}
 
 	//-----------------------------------------------------------------------------
@@ -60,27 +103,50 @@ public:
 	std::future_status wait_for(const std::chrono::duration<Rep, Per>& rel_time) const
 	{
 		// wait for duration
-		return future_.wait_for(rel_time);
+		if(is_ready())
+		{
+			return std::future_status::ready;
+		}
+
+		if(!valid() || rel_time <= rel_time.zero())
+		{
+			return std::future_status::timeout;
+		}
+
+		const auto abs_time =
+			std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(rel_time);
+		return state_->wait_until(abs_time) ? std::future_status::ready : std::future_status::timeout;
 	}
 
 	template <class Clock, class Dur>
 	std::future_status wait_until(const std::chrono::time_point<Clock, Dur>& abs_time) const
 	{
 		// wait until time point
-		return future_.wait_until(abs_time);
+		return wait_for(abs_time - Clock::now());
 	}
 
-	static task_future<T> from_shared_future(std::shared_future<T>&& fut, std::uint64_t id = 0)
+	//-----------------------------------------------------------------------------
+	//  Name : on_complete ()
+	/// <summary>
+	/// Calls 'f' once the task is done, on the thread that completed it, or
+	/// right away if it already is. Keep 'f' short, pushing a task is fine.
+	/// Returns false and drops 'f' when the future is not valid.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool on_complete(task_continuation f) const
 	{
-		task_future<T> res;
-		res.future_ = std::move(fut);
-		res.id_ = id;
-		return res;
+		if(!state_)
+		{
+			return false;
+		}
+
+		state_->then(std::move(f));
+		return true;
 	}
 
 	std::uint64_t get_id() const
 	{
-		return id_;
+		return state_ ? state_->get_id() : 0;
 	}
 
 	template <typename F>
@@ -90,19 +156,26 @@ public:
 
 private:
 	friend class task_system;
-	std::shared_future<T> future_;
+	friend class task;
+
+	/// takes over a reference of 'state'
+	explicit task_future(detail::task_result<T>* state) noexcept
+		: state_(state)
+	{
+	}
+
+	detail::task_result<T>* state_ = nullptr;
 	task_system* executor_ = nullptr;
-	std::uint64_t id_ = 0;
 };
 
 /*
- * awaitable_task; a type-erased, std::packaged_task that
- * also contains its own arguments.
+ * awaitable_task; a type-erased task that also contains its own
+ * arguments. It lives in a pooled task_state it shares with its futures.
  *
  * There are two forms of tasks: ready tasks and awaitable tasks.
  *
  *      Ready tasks are assumed to be immediately invokable; that is,
- *      invoking the underlying pakcaged_task with the provided arguments
+ *      invoking the underlying callable with the provided arguments
  *      will not block. This is contrasted with awaitable tasks where some or
  *      all of the provided arguments may be futures waiting on results of
  *      other tasks.
@@ -114,7 +187,7 @@ private:
  *
  * There are two helper methods for creating task objects:
  * make_ready_task and make_awaitable_task, both of which return a pair of
- * the newly constructed task and a std::future object to the
+ * the newly constructed task and a task_future object to the
  * return value.
  */
 
@@ -132,22 +205,31 @@ class task
 	template <typename F, typename... Args>
 	using invoke_result_t = typename hpp::function_traits<F>::result_type;
 
-	struct ready_task_tag
-	{
-	};
-	struct awaitable_task_tag
-	{
-	};
-
 public:
 	task() = default;
-	~task() = default;
+	~task()
+	{
+		reset();
+	}
 
 	task(task const&) = delete;
-	task(task&&) noexcept = default;
+	task(task&& other) noexcept
+		: t_(other.t_)
+	{
+		other.t_ = nullptr;
+	}
 
 	task& operator=(task const&) = delete;
-	task& operator=(task&&) noexcept = default;
+	task& operator=(task&& other) noexcept
+	{
+		if(this != &other)
+		{
+			reset();
+			t_ = other.t_;
+			other.t_ = nullptr;
+		}
+		return *this;
+	}
 
 	void swap(task& other) noexcept
 	{
@@ -156,31 +238,23 @@ public:
 
 	operator bool() const noexcept
 	{
-		return static_cast<bool>(t_);
+		return t_ != nullptr;
 	}
 
 	template <class F, class... Args>
 	static decltype(auto) make_ready_task(F&& f, Args&&... args)
 	{
 		using invoke_res = invoke_result_t<F, Args...>;
-		using pair_type = std::pair<task, task_future<invoke_res>>;
-		using model_type = ready_task_model<invoke_res(Args...)>;
-
-		task t(ready_task_tag(), std::forward<F>(f), std::forward<Args>(args)...);
-		auto fut = static_cast<model_type&>(*t.t_).get_future();
-		return pair_type(std::move(t), std::move(fut));
+		using model_type = ready_task_model<std::decay_t<F>, invoke_res, Args...>;
+		return make_task<model_type, invoke_res>(std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
 	template <class F, class... Args>
 	static decltype(auto) make_awaitable_task(F&& f, Args&&... args)
 	{
 		using invoke_res = invoke_result_t<F, Args...>;
-		using pair_type = std::pair<task, task_future<invoke_res>>;
-		using model_type = awaitable_task_model<invoke_res(decay_if_future_t<Args>...), Args...>;
-
-		task t(awaitable_task_tag(), std::forward<F>(f), std::forward<Args>(args)...);
-		auto fut = static_cast<model_type&>(*t.t_).get_future();
-		return pair_type(std::move(t), std::move(fut));
+		using model_type = awaitable_task_model<std::decay_t<F>, invoke_res, Args...>;
+		return make_task<model_type, invoke_res>(std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
 	void operator()()
@@ -204,82 +278,189 @@ public:
 	{
 		if(t_)
 		{
-			return t_->id_;
+			return t_->get_id();
 		}
 
 		return 0;
 	}
 
 private:
-	template <class F, class... Args>
-	task(ready_task_tag /*unused*/, F&& f, Args&&... args) noexcept
-		: t_(new ready_task_model<invoke_result_t<F, Args...>(Args...)>(std::forward<F>(f),
-																		std::forward<Args>(args)...))
+	friend class task_system;
+
+	explicit task(detail::task_state* t) noexcept
+		: t_(t)
 	{
 	}
 
-	template <class F, class... Args>
-	task(awaitable_task_tag /*unused*/, F&& f, Args&&... args) noexcept
-		: t_(new awaitable_task_model<invoke_result_t<F, Args...>(decay_if_future_t<Args>...), Args...>(
-			  std::forward<F>(f), std::forward<Args>(args)...))
+	detail::task_state* release() noexcept
 	{
+		auto t = t_;
+		t_ = nullptr;
+		return t;
 	}
 
-	struct task_concept
+	void reset() noexcept
 	{
-		task_concept() noexcept;
-		virtual ~task_concept() noexcept;
-		virtual void invoke_() = 0;
-		virtual bool ready_() const noexcept = 0;
-		std::uint64_t id_ = 0;
-	};
+		if(t_)
+		{
+			t_->discard_();
+			t_->release();
+			t_ = nullptr;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : make_task ()
+	/// <summary>
+	/// Creates a model in the task memory pool. The task and the future each
+	/// hold a reference to it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class Model, class R, class F, class... Args>
+	static std::pair<task, task_future<R>> make_task(F&& f, Args&&... args)
+	{
+		static_assert(alignof(Model) <= alignof(std::max_align_t), "over-aligned task arguments");
+
+		auto memory = detail::allocate_task_memory(sizeof(Model));
+		Model* model = nullptr;
+		try
+		{
+			model = ::new(memory) Model(std::forward<F>(f), std::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			detail::deallocate_task_memory(memory, sizeof(Model));
+			throw;
+		}
+
+		model->add_ref();
+		return std::pair<task, task_future<R>>(task(model), task_future<R>(model));
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : task_model ()
+	/// <summary>
+	/// Holds the callable and its arguments in place until the task runs or
+	/// is dropped, then only the result is kept.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class Derived, class F, class R, class... Stored>
+	struct task_model : detail::task_result<R>
+	{
+		using payload_type = std::pair<F, std::tuple<Stored...>>;
+
+		template <class Fn, class... Args>
+		explicit task_model(Fn&& f, Args&&... args)
+		{
+			::new(&payload_) payload_type(std::piecewise_construct, std::forward_as_tuple(std::forward<Fn>(f)),
+										  std::forward_as_tuple(std::forward<Args>(args)...));
+			alive_ = true;
+		}
+
+		~task_model() override
+		{
+			destroy_payload();
+		}
+
+		void invoke_() override
+		{
+			if(!alive_)
+			{
+				return;
+			}
+
+			try
+			{
+				static_cast<Derived*>(this)->call_(std::is_void<R>());
+			}
+			catch(...)
+			{
+				this->set_exception(std::current_exception());
+			}
+
+			// The captures are released before anyone sees the result.
+			destroy_payload();
+			this->set_ready();
+		}
+
+		void discard_() noexcept override
+		{
+			if(!alive_)
+			{
+				return;
+			}
+
+			destroy_payload();
+			this->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			this->set_ready();
+		}
+
+		void destroy_() noexcept override
+		{
+			auto model = static_cast<Derived*>(this);
+			model->~Derived();
+			detail::deallocate_task_memory(model, sizeof(Derived));
+		}
+
+		payload_type& payload() noexcept
+		{
+			return *reinterpret_cast<payload_type*>(&payload_);
+		}
 
-	template <class>
-	struct ready_task_model;
+		const payload_type& payload() const noexcept
+		{
+			return *reinterpret_cast<const payload_type*>(&payload_);
+		}
+
+	private:
+		void destroy_payload() noexcept
+		{
+			if(alive_)
+			{
+				payload().~payload_type();
+				alive_ = false;
+			}
+		}
+
+		std::aligned_storage_t<sizeof(payload_type), alignof(payload_type)> payload_;
+		bool alive_ = false;
+	};
 
 	//-----------------------------------------------------------------------------
 	//  Name : ready_task_model ()
 	/// <summary>
 	/// Ready tasks are assumed to be immediately invokable, that is,
-	/// invoking the underlying pakcaged_task with the provided arguments
+	/// invoking the underlying callable with the provided arguments
 	/// will not block. This is contrasted with async tasks where some or all
 	/// of the provided arguments may be futures waiting on results of other
 	/// tasks.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	template <class R, class... Args>
-	struct ready_task_model<R(Args...)> : task_concept
+	template <class F, class R, class... Args>
+	struct ready_task_model final
+		: task_model<ready_task_model<F, R, Args...>, F, R, hpp::special_decay_t<Args>...>
 	{
-		template <class F>
-		explicit ready_task_model(F&& f, Args&&... args) noexcept
-			: f_(std::forward<F>(f))
-			, args_(std::forward<Args>(args)...)
-		{
-		}
+		using base_type = task_model<ready_task_model<F, R, Args...>, F, R, hpp::special_decay_t<Args>...>;
+		using base_type::base_type;
 
-		task_future<R> get_future()
+		void call_(std::true_type /*is_void*/)
 		{
-			return task_future<R>::from_shared_future(f_.get_future().share(), id_);
+			auto& p = this->payload();
+			hpp::apply(p.first, p.second);
 		}
 
-		void invoke_() override
+		void call_(std::false_type /*is_void*/)
 		{
-			hpp::apply(f_, args_);
+			auto& p = this->payload();
+			this->set_value(hpp::apply(p.first, p.second));
 		}
 
 		bool ready_() const noexcept override
 		{
 			return true;
 		}
-
-	private:
-		std::packaged_task<R(Args...)> f_;
-		std::tuple<hpp::special_decay_t<Args>...> args_;
 	};
 
-	template <class...>
-	struct awaitable_task_model;
-
 	//-----------------------------------------------------------------------------
 	//  Name : awaitable_task_model ()
 	/// <summary>
@@ -289,38 +470,34 @@ private:
 	/// invokable.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	template <class R, class... CallArgs, class... FutArgs>
-	struct awaitable_task_model<R(CallArgs...), FutArgs...> : task_concept
+	template <class F, class R, class... FutArgs>
+	struct awaitable_task_model final
+		: task_model<awaitable_task_model<F, R, FutArgs...>, F, R, hpp::special_decay_t<FutArgs>...>
 	{
-		template <class F, class... Args>
-		explicit awaitable_task_model(F&& f, Args&&... args) noexcept
-			: f_(std::forward<F>(f))
-			, args_(std::forward<Args>(args)...)
+		using base_type =
+			task_model<awaitable_task_model<F, R, FutArgs...>, F, R, hpp::special_decay_t<FutArgs>...>;
+		using base_type::base_type;
+
+		void call_(std::true_type /*is_void*/)
 		{
+			do_invoke_(std::make_index_sequence<sizeof...(FutArgs)>());
 		}
 
-		task_future<R> get_future()
+		void call_(std::false_type /*is_void*/)
 		{
-			return task_future<R>::from_shared_future(f_.get_future().share(), id_);
+			this->set_value(do_invoke_(std::make_index_sequence<sizeof...(FutArgs)>()));
 		}
 
-		void invoke_() override
+		bool ready_() const noexcept override
 		{
 			constexpr const std::size_t arity = sizeof...(FutArgs);
-			try
-			{
-				do_invoke_(std::make_index_sequence<arity>());
-			}
-			catch(const std::future_error& e)
-			{
-				(void)e;
-			}
+			return do_ready_(std::make_index_sequence<arity>());
 		}
 
-		bool ready_() const noexcept override
+		bool when_ready_(task_system& system, std::size_t idx) override
 		{
 			constexpr const std::size_t arity = sizeof...(FutArgs);
-			return do_ready_(std::make_index_sequence<arity>());
+			return do_when_ready_(system, idx, std::make_index_sequence<arity>());
 		}
 
 	private:
@@ -337,16 +514,10 @@ private:
 		}
 
 		template <std::size_t... I>
-		inline void do_invoke_(std::index_sequence<I...> /*unused*/)
+		inline decltype(auto) do_invoke_(std::index_sequence<I...> /*unused*/)
 		{
-			try
-			{
-				hpp::invoke(f_, call_get(std::get<I>(std::move(args_)))...);
-			}
-			catch(const std::future_error& e)
-			{
-				(void)e;
-			}
+			auto& p = this->payload();
+			return hpp::invoke(p.first, call_get(std::get<I>(std::move(p.second)))...);
 		}
 
 		template <typename T, typename std::enable_if_t<!is_future<T>::value>* = nullptr>
@@ -354,7 +525,7 @@ private:
 		{
 			return true;
 		}
-            
+
 		template <typename T, typename std::enable_if_t<is_future<T>::value>* = nullptr>
 		static inline bool call_ready(const T& t) noexcept
 		{
@@ -365,14 +536,99 @@ private:
 		template <std::size_t... I>
 		inline bool do_ready_(std::index_sequence<I...> /*unused*/) const noexcept
 		{
-			return hpp::check_all_true(call_ready(std::get<I>(args_))...);
+			return hpp::check_all_true(call_ready(std::get<I>(this->payload().second))...);
+		}
+
+		/// other futures can only be polled
+		template <typename T>
+		static inline bool can_notify(const T& t) noexcept
+		{
+			return call_ready(t);
+		}
+
+		template <typename U>
+		static inline bool can_notify(const task_future<U>& t) noexcept
+		{
+			return t.valid();
+		}
+
+		template <typename T>
+		inline bool notify(const T& /*unused*/)
+		{
+			return true;
+		}
+
+		template <typename U>
+		inline bool notify(const task_future<U>& t)
+		{
+			pending_.fetch_add(1, std::memory_order_relaxed);
+			t.on_complete([this]() { input_ready(); });
+			return true;
+		}
+
+		template <std::size_t... I>
+		inline bool do_when_ready_(task_system& system, std::size_t idx, std::index_sequence<I...> /*unused*/)
+		{
+			const auto& args = this->payload().second;
+			if(!hpp::check_all_true(can_notify(std::get<I>(args))...))
+			{
+				return false;
+			}
+
+			system_ = &system;
+			target_ = idx;
+			// Holds one extra count until every argument is registered, so the
+			// task is pushed once, after the last of them.
+			pending_.store(1, std::memory_order_relaxed);
+			hpp::check_all_true(notify(std::get<I>(args))...);
+			input_ready();
+			return true;
+		}
+
+		void input_ready()
+		{
+			if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				detail::on_inputs_ready(*system_, this, target_);
+			}
 		}
 
-		std::packaged_task<R(CallArgs...)> f_;
-		std::tuple<hpp::special_decay_t<FutArgs>...> args_;
+		std::atomic<std::size_t> pending_{0};
+		task_system* system_ = nullptr;
+		std::size_t target_ = 0;
 	};
 
-	std::unique_ptr<task_concept> t_;
+	detail::task_state* t_ = nullptr;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : task_priority (Enum)
+/// <summary>
+/// Order in which the threads of a pool take queued tasks. A task only starts
+/// when no task of a higher priority is waiting, running tasks are never
+/// interrupted.
+/// </summary>
+//-----------------------------------------------------------------------------
+enum class task_priority : std::uint8_t
+{
+	/// work the current frame waits for
+	frame_critical,
+	normal,
+	/// work that may lag by frames, like asset hot reloads
+	background,
+};
+
+//-----------------------------------------------------------------------------
+//  Name : task_pool (Enum)
+/// <summary>
+/// The threads a task runs on. Tasks that block on files or child processes
+/// go to the io pool, so they do not hold up the compute workers.
+/// </summary>
+//-----------------------------------------------------------------------------
+enum class task_pool : std::uint8_t
+{
+	compute,
+	io,
 };
 
 class task_system
@@ -394,7 +650,14 @@ public:
 
 	task_system(bool wait_on_destruct);
 
-	task_system(bool wait_on_destruct, std::size_t nthreads);
+	//-----------------------------------------------------------------------------
+	//  Name : task_system ()
+	/// <summary>
+	/// 'nthreads' counts the owner thread, the other ones are compute workers.
+	/// With no io threads, io tasks run on the compute workers.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	task_system(bool wait_on_destruct, std::size_t nthreads, std::size_t io_threads = default_io_threads);
 
 	//-----------------------------------------------------------------------------
 	//  Name : ~task_system ()
@@ -412,6 +675,13 @@ public:
 	//-----------------------------------------------------------------------------
 	void run_on_owner_thread(duration_t max_duration = duration_t(0));
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_info ()
+	/// <summary>
+	/// Counts the pending tasks of every queue. Locks each of them, meant for
+	/// tools rather than for every frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
 	system_info get_info() const;
 	//-----------------------------------------------------------------------------
 	//  Name : get_owner_thread_idx ()
@@ -426,16 +696,27 @@ public:
 		return 0;
 	}
 
+	/// whether the calling thread is the one that created the system
+	bool is_owner_thread() const
+	{
+		return std::this_thread::get_id() == owner_thread_id_;
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_any_worker_thread_idx ()
 	/// <summary>
-	/// Gets one of the worker threads id. Can be used to push a task directly
-	/// there.
+	/// Gets one of the worker threads id, in turns. Can be used to push a task
+	/// directly there.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	std::size_t get_any_worker_thread_idx() const
+	std::size_t get_any_worker_thread_idx()
 	{
-		return get_most_free_queue_idx(true);
+		if(threads_count_ == 1)
+		{
+			return get_owner_thread_idx();
+		}
+
+		return 1 + next_worker_.fetch_add(1, std::memory_order_relaxed) % (threads_count_ - 1);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -503,14 +784,28 @@ public:
 	//  Name : push_on_worker_thread ()
 	/// <summary>
 	/// Pushes a task to a worker thread to be executed when it can.
-	/// Either a ready task or an awaitable one
+	/// Either a ready task or an awaitable one. Ready tasks pushed from a worker
+	/// go to its own deque, where idle workers steal them from.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	template <class F, class... Args>
 	decltype(auto) push_on_worker_thread(F&& f, Args&&... args)
 	{
-		const std::size_t idx = get_any_worker_thread_idx();
-		return push_on_thread(idx, std::forward<F>(f), std::forward<Args>(args)...);
+		return push_on_thread(any_worker_idx, std::forward<F>(f), std::forward<Args>(args)...);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_on_pool ()
+	/// <summary>
+	/// Pushes a task to a pool with a priority. Normal compute tasks are the
+	/// ones push_on_worker_thread pushes.
+	/// Either a ready task or an awaitable one
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class F, class... Args>
+	decltype(auto) push_on_pool(task_pool pool, task_priority priority, F&& f, Args&&... args)
+	{
+		return push_on_thread(get_pool_idx(pool, priority), std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -558,8 +853,7 @@ public:
 	template <class F, class... Args>
 	decltype(auto) push_or_execute_on_worker_thread(F&& f, Args&&... args)
 	{
-		const std::size_t idx = get_any_worker_thread_idx();
-		return push_or_execute_on_thread(idx, std::forward<F>(f), std::forward<Args>(args)...);
+		return push_or_execute_on_thread(any_worker_idx, std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -580,7 +874,139 @@ public:
 		return push_or_execute_on_thread(idx, std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_for ()
+	/// <summary>
+	/// Calls f(first, last) over sub ranges covering [begin, end), in parallel.
+	/// The range is halved until it is at most 'grain' long, the halves that
+	/// are split off are pushed on the workers where idle ones steal them.
+	/// The calling thread runs the first chunk and then helps with any worker
+	/// task until every chunk is done. The first exception thrown by 'f' is
+	/// rethrown here, the chunks that did not start yet are skipped.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, const F& f,
+					  task_priority priority = task_priority::normal)
+	{
+		if(begin >= end)
+		{
+			return;
+		}
+
+		grain = std::max<std::size_t>(grain, 1);
+		if(threads_count_ == 1 || end - begin <= grain)
+		{
+			f(begin, end);
+			return;
+		}
+
+		parallel_state state;
+		state.priority = priority;
+		state.pending.store(1, std::memory_order_relaxed);
+		run_range(state, begin, end, grain, f);
+		help_while([&state]() { return state.pending.load(std::memory_order_acquire) != 0; },
+				   priority == task_priority::background);
+
+		if(state.error)
+		{
+			std::rethrow_exception(state.error);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_reduce ()
+	/// <summary>
+	/// Maps the sub ranges of [begin, end) to partial results in parallel with
+	/// map(first, last), like parallel_for does, then folds them from left to
+	/// right with reduce(accumulated, partial), starting at 'identity'.
+	/// 'reduce' must be associative, it does not have to be commutative.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T, typename Map, typename Reduce>
+	T parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, const Map& map,
+					  const Reduce& reduce, task_priority priority = task_priority::normal)
+	{
+		std::mutex mutex;
+		std::vector<std::pair<std::size_t, T>> partials;
+		parallel_for(begin, end, grain, [&mutex, &partials, &map](std::size_t first, std::size_t last) {
+			auto partial = map(first, last);
+			std::lock_guard<std::mutex> lock(mutex);
+			partials.emplace_back(first, std::move(partial));
+		}, priority);
+
+		std::sort(std::begin(partials), std::end(partials),
+				  [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+		T result = std::move(identity);
+		for(auto& partial : partials)
+		{
+			result = reduce(std::move(result), std::move(partial.second));
+		}
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : wait_all ()
+	/// <summary>
+	/// Waits until every future is ready, running worker tasks on the calling
+	/// thread meanwhile, like parallel_for does. Meant for compute pool tasks
+	/// pushed with 'priority'. Does not rethrow, get() the futures for that.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	void wait_all(const std::vector<task_future<T>>& futures, task_priority priority = task_priority::normal)
+	{
+		help_while(
+			[&futures]() {
+				return std::any_of(std::begin(futures), std::end(futures),
+								   [](const task_future<T>& f) { return f.valid() && !f.is_ready(); });
+			},
+			priority == task_priority::background);
+	}
+
+	static constexpr std::size_t default_io_threads = 2;
+
 private:
+	/// push_task target letting the system pick a worker
+	static constexpr std::size_t any_worker_idx = std::size_t(-1);
+	/// push_task targets from this one on are the shared_queues_
+	static constexpr std::size_t shared_queue_idx = std::size_t(-8);
+
+	/// shared_queues_ slots
+	enum shared_queue : std::size_t
+	{
+		compute_critical_queue,
+		compute_background_queue,
+		/// one per priority
+		io_queue,
+		shared_queues_count = io_queue + 3,
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_pool_idx ()
+	/// <summary>
+	/// Gets the push_task target of a pool and priority.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t get_pool_idx(task_pool pool, task_priority priority) const
+	{
+		if(pool == task_pool::io && !io_threads_.empty())
+		{
+			return shared_queue_idx + io_queue + static_cast<std::size_t>(priority);
+		}
+
+		switch(priority)
+		{
+			case task_priority::frame_critical:
+				return shared_queue_idx + compute_critical_queue;
+			case task_priority::background:
+				return shared_queue_idx + compute_background_queue;
+			default:
+				return any_worker_idx;
+		}
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : push_impl ()
 	/// <summary>
@@ -607,14 +1033,24 @@ private:
 	/// Awaitable tasks are assumed to take arguments where some or all are
 	/// backed by futures waiting on results of other tasks.This is
 	/// contrasted with ready tasks that are assumed to be immediately invokable.
+	/// Unless its arguments are ready already, the task is held back and only
+	/// queued once they are.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	template <class F, class... Args>
 	decltype(auto) push_impl(std::false_type /*unused*/, std::size_t idx, bool execute_if_ready, F&& f,
 							 Args&&... args)
 	{
-		return push_task(task::make_awaitable_task(std::forward<F>(f), std::forward<Args>(args)...), idx,
-						 execute_if_ready);
+		auto t = task::make_awaitable_task(std::forward<F>(f), std::forward<Args>(args)...);
+		if(t.first.ready())
+		{
+			return push_task(std::move(t), idx, execute_if_ready);
+		}
+
+		auto future = std::move(t.second);
+		future.executor_ = this;
+		push_when_ready(std::move(t.first), idx);
+		return future;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -637,6 +1073,25 @@ private:
 	{
 		t.second.executor_ = this;
 
+		if(idx == any_worker_idx)
+		{
+			if(execute_if_ready && threads_count_ > 1 && t.first.ready())
+			{
+				t.first();
+
+				return std::move(t.second);
+			}
+
+			push_on_any_worker(std::move(t.first));
+			return std::move(t.second);
+		}
+
+		if(idx >= shared_queue_idx)
+		{
+			push_ready(std::move(t.first), idx);
+			return std::move(t.second);
+		}
+
 		const auto queue_index = get_thread_queue_idx(idx);
 		if(execute_if_ready && t.first.ready() &&
 		   ((get_thread_id(queue_index) == std::this_thread::get_id()) || (queue_index != 0)))
@@ -646,10 +1101,147 @@ private:
 			return std::move(t.second);
 		}
 
-		queues_[queue_index].push(std::move(t.first));
+		push_ready(std::move(t.first), idx);
 		return std::move(t.second);
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : push_ready ()
+	/// <summary>
+	/// Queues a task on the thread 'idx', or on any worker.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_ready(task t, std::size_t idx);
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_when_ready ()
+	/// <summary>
+	/// Queues an awaitable task from a continuation of its last pending
+	/// future, so the queues only hold tasks that can run. Tasks waiting on
+	/// futures that can not notify are queued right away and polled.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_when_ready(task t, std::size_t idx);
+	friend void detail::on_inputs_ready(task_system& system, detail::task_state* state, std::size_t idx);
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_inputs_ready ()
+	/// <summary>
+	/// Queues a task held back by push_when_ready, or drops it once the system
+	/// is stopping.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_inputs_ready(detail::task_state* state, std::size_t idx);
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_on_any_worker ()
+	/// <summary>
+	/// Ready tasks pushed from a worker thread go to its deque without locking.
+	/// Everything else goes to the worker queues in turns.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_on_any_worker(task t);
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_shared ()
+	/// <summary>
+	/// Pushes a task on one of the shared_queues_ and wakes a thread of its
+	/// pool up.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_shared(task t, std::size_t slot);
+	task pop_shared(std::size_t slot);
+
+	//-----------------------------------------------------------------------------
+	//  Name : wake_up_worker ()
+	/// <summary>
+	/// Wakes up one parked worker, if any. Costs one atomic load when every
+	/// worker is busy.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void wake_up_worker();
+
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_state (Struct)
+	/// <summary>
+	/// Shared by the chunks of one parallel_for, lives on the caller's stack.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	struct parallel_state
+	{
+		void fail(std::exception_ptr e)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!error)
+			{
+				error = std::move(e);
+			}
+			failed.store(true, std::memory_order_relaxed);
+		}
+
+		/// chunks pushed and not finished yet
+		std::atomic<std::size_t> pending{0};
+		task_priority priority = task_priority::normal;
+		std::atomic<bool> failed{false};
+		std::mutex mutex;
+		std::exception_ptr error;
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : run_range ()
+	/// <summary>
+	/// Splits off the upper halves of [begin, end) as worker tasks, then runs
+	/// what is left. Counted in state.pending by the caller.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void run_range(parallel_state& state, std::size_t begin, std::size_t end, std::size_t grain, const F& f)
+	{
+		while(end - begin > grain)
+		{
+			const auto middle = begin + (end - begin) / 2;
+			state.pending.fetch_add(1, std::memory_order_relaxed);
+			push_on_pool(task_pool::compute, state.priority, [this, &state, middle, end, grain, &f]() {
+				run_range(state, middle, end, grain, f);
+			});
+			end = middle;
+		}
+
+		if(!state.failed.load(std::memory_order_relaxed))
+		{
+			try
+			{
+				f(begin, end);
+			}
+			catch(...)
+			{
+				state.fail(std::current_exception());
+			}
+		}
+
+		// The last access to the state, the caller may return right after.
+		state.pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : help_while ()
+	/// <summary>
+	/// Runs worker tasks on the calling thread while 'condition' holds. Worker
+	/// threads take them the way they usually do, other threads steal them.
+	/// The owner thread also runs its own queue, where the pool's tasks go
+	/// when there are no workers. Background tasks may take long, workers only
+	/// take them when 'allow_background' is set, as when waiting on some.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void help_while(const std::function<bool()>& condition, bool allow_background);
+
+	//-----------------------------------------------------------------------------
+	//  Name : cancel ()
+	/// <summary>
+	/// Removes a task from the queues. Tasks in the worker deques can not be
+	/// cancelled, they are waited for instead.
+	/// </summary>
+	//-----------------------------------------------------------------------------
 	bool cancel(std::uint64_t id)
 	{
 		bool cancelled = false;
@@ -665,6 +1257,11 @@ private:
 			}
 		}
 
+		for(std::size_t i = 0; i < shared_queues_.size() && !cancelled; ++i)
+		{
+			cancelled = shared_queues_[i].cancel(id);
+		}
+
 		return cancelled;
 	}
 	//-----------------------------------------------------------------------------
@@ -718,6 +1315,45 @@ private:
 	void run(std::size_t idx, const std::function<bool()>& condition,
 			 duration_t pop_timeout = duration_t::max());
 
+	//-----------------------------------------------------------------------------
+	//  Name : find_work ()
+	/// <summary>
+	/// Takes the next task of a worker. Frame critical tasks come first, then
+	/// its own deque, newest task first, then its queue, then the oldest tasks
+	/// of the other workers and last the background tasks, unless
+	/// 'allow_background' is false.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	task find_work(std::size_t idx, bool allow_background = true);
+
+	//-----------------------------------------------------------------------------
+	//  Name : steal_work ()
+	/// <summary>
+	/// Takes the oldest task of a worker other than 'idx', from its deque or
+	/// its queue.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	task steal_work(std::size_t idx);
+
+	//-----------------------------------------------------------------------------
+	//  Name : park ()
+	/// <summary>
+	/// Sleeps until a task is pushed, the system is done or the timeout
+	/// passes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void park(std::size_t idx, duration_t timeout);
+	bool has_worker_tasks() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : run_io ()
+	/// <summary>
+	/// Main loop of the io threads, they take the io queues by priority.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void run_io();
+	bool has_io_tasks() const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_thread_queue_idx ()
 	/// <summary>
@@ -743,6 +1379,9 @@ private:
 		task_queue(task_queue&& other) noexcept;
 
 		std::size_t get_pending_tasks() const;
+		bool has_ready_tasks() const;
+		/// without locking, may be outdated
+		bool is_empty() const;
 		void set_done();
 		bool is_done() const;
 		std::pair<bool, task> try_pop();
@@ -756,16 +1395,43 @@ private:
 		void clear();
 
 	private:
-		void sort();
-		std::deque<task> tasks_;
+		void requeue_front();
+		void push_back(task t);
+		task pop_front();
+		/// the queued tasks are tasks_[head_, tasks_.size())
+		std::vector<task> tasks_;
+		std::size_t head_ = 0;
 		std::condition_variable cv_;
 		mutable std::mutex mutex_;
 		std::atomic_bool done_{false};
+		/// size of tasks_, written under the mutex
+		std::atomic<std::size_t> size_{0};
 	};
 
+	using task_deque = work_stealing_deque<detail::task_state*>;
+
+	/// set once tasks held back by push_when_ready are dropped instead
+	std::atomic<bool> stopping_{false};
 	std::vector<task_queue> queues_;
+	/// by thread index, the owner thread has none
+	std::vector<std::unique_ptr<task_deque>> deques_;
+	/// queues of every thread of a pool, see shared_queue
+	std::array<task_queue, shared_queues_count> shared_queues_;
 	std::vector<std::thread> threads_;
+	std::vector<std::thread> io_threads_;
+
+	/// guards the io threads' sleep and io_done_
+	std::mutex io_mutex_;
+	std::condition_variable io_cv_;
+	bool io_done_ = false;
 	std::size_t threads_count_;
+	std::atomic<std::size_t> next_worker_{0};
+
+	/// guards parked workers' sleep and wake_epoch_
+	std::mutex park_mutex_;
+	std::condition_variable park_cv_;
+	std::atomic<std::size_t> parked_{0};
+	std::uint64_t wake_epoch_ = 0;
 	//
 	const std::thread::id owner_thread_id_ = std::this_thread::get_id();
 	bool wait_on_destruct_ = false;
@@ -786,7 +1452,7 @@ inline decltype(auto) task_future<T>::then_on_owner(F&& f)
 template <typename T>
 inline void task_future<T>::wait() const
 {
-	if(!future_.valid())
+	if(!state_)
 	{
 		return;
 	}
@@ -797,12 +1463,12 @@ inline void task_future<T>::wait() const
 		{
 			if(!executor_->processing_wait(*this))
 			{
-				future_.wait();
+				state_->wait();
 			}
 		}
 		else
 		{
-			future_.wait();
+			state_->wait();
 		}
 	}
 }
@@ -810,14 +1476,14 @@ inline void task_future<T>::wait() const
 template <typename T>
 inline void task_future<T>::cancel() const
 {
-	if(!future_.valid())
+	if(!state_)
 	{
 		return;
 	}
 
 	if(executor_)
 	{
-		bool cancelled = executor_->cancel(id_);
+		bool cancelled = executor_->cancel(get_id());
 
 		if(!cancelled)
 		{
@@ -0,0 +1,184 @@
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+//-----------------------------------------------------------------------------
+//  Name : work_stealing_deque (Class)
+/// <summary>
+/// Chase-Lev deque of pointers, following "Correct and Efficient
+/// Work-Stealing for Weak Memory Models" (Le et al. 2013). The owning thread
+/// pushes and pops at the bottom without locks or read-modify-writes, except
+/// when it races a thief for the last element. Any thread steals from the top
+/// with a CAS. The ring grows when full, retired rings are kept until the
+/// deque is destroyed since a thief may still read from them.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+class work_stealing_deque
+{
+	static_assert(std::is_pointer<T>::value, "work_stealing_deque stores pointers");
+
+public:
+	explicit work_stealing_deque(std::int64_t capacity = 1024)
+	{
+		rings_.emplace_back(std::make_unique<ring>(capacity));
+		ring_.store(rings_.back().get(), std::memory_order_relaxed);
+	}
+
+	work_stealing_deque(const work_stealing_deque&) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+	//-----------------------------------------------------------------------------
+	//  Name : push ()
+	/// <summary>
+	/// Adds an element at the bottom. Owner thread only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push(T item)
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed);
+		const auto t = top_.load(std::memory_order_acquire);
+		auto r = ring_.load(std::memory_order_relaxed);
+		if(b - t > r->capacity - 1)
+		{
+			r = grow(r, b, t);
+		}
+
+		r->put(b, item);
+		// Publishes the element to the thieves, the paper's release fence.
+		bottom_.store(b + 1, std::memory_order_release);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : pop ()
+	/// <summary>
+	/// Removes the newest element, nullptr when empty. Owner thread only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	T pop()
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+		auto r = ring_.load(std::memory_order_relaxed);
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto t = top_.load(std::memory_order_relaxed);
+
+		T item = nullptr;
+		if(t <= b)
+		{
+			item = r->get(b);
+			if(t == b)
+			{
+				// The last element, a thief may be taking it too.
+				if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+												 std::memory_order_relaxed))
+				{
+					item = nullptr;
+				}
+				bottom_.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			bottom_.store(b + 1, std::memory_order_relaxed);
+		}
+
+		return item;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : steal ()
+	/// <summary>
+	/// Removes the oldest element, nullptr when empty or when another thread
+	/// won the race for it. Any thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	T steal()
+	{
+		auto t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const auto b = bottom_.load(std::memory_order_acquire);
+		if(t >= b)
+		{
+			return nullptr;
+		}
+
+		auto r = ring_.load(std::memory_order_acquire);
+		T item = r->get(t);
+		if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+
+		return item;
+	}
+
+	/// approximate when other threads are working on the deque
+	std::size_t size() const
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed);
+		const auto t = top_.load(std::memory_order_relaxed);
+		return b > t ? std::size_t(b - t) : 0;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+private:
+	struct ring
+	{
+		explicit ring(std::int64_t cap)
+			: capacity(cap)
+			, mask(cap - 1)
+			, slots(new std::atomic<T>[std::size_t(cap)])
+		{
+		}
+
+		void put(std::int64_t index, T item)
+		{
+			slots[std::size_t(index & mask)].store(item, std::memory_order_relaxed);
+		}
+
+		T get(std::int64_t index) const
+		{
+			return slots[std::size_t(index & mask)].load(std::memory_order_relaxed);
+		}
+
+		/// a power of two
+		const std::int64_t capacity;
+		const std::int64_t mask;
+		std::unique_ptr<std::atomic<T>[]> slots;
+	};
+
+	ring* grow(ring* old, std::int64_t b, std::int64_t t)
+	{
+		rings_.emplace_back(std::make_unique<ring>(old->capacity * 2));
+		auto r = rings_.back().get();
+		for(auto i = t; i < b; ++i)
+		{
+			r->put(i, old->get(i));
+		}
+
+		ring_.store(r, std::memory_order_release);
+		return r;
+	}
+
+	/// top and bottom are on their own cache lines, thieves only write top
+	alignas(64) std::atomic<std::int64_t> top_{0};
+	alignas(64) std::atomic<std::int64_t> bottom_{0};
+	alignas(64) std::atomic<ring*> ring_{nullptr};
+	/// every ring ever used, only touched by the owner
+	std::vector<std::unique_ptr<ring>> rings_;
+};
+} // namespace core
+
+#endif // #ifndef WORK_STEALING_DEQUE_HPP
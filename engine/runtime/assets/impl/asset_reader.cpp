@@ -110,7 +110,7 @@ bool load_from_file<gfx::texture>(core::task_future<asset_handle<gfx::texture>>&
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -197,7 +197,7 @@ bool load_from_file<gfx::shader>(core::task_future<asset_handle<gfx::shader>>& o
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -289,7 +289,7 @@ bool load_from_file<mesh>(core::task_future<asset_handle<mesh>>& output, const s
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -369,7 +369,7 @@ bool load_from_file<audio::sound>(core::task_future<asset_handle<audio::sound>>&
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -450,7 +450,7 @@ bool load_from_file<runtime::animation>(core::task_future<asset_handle<runtime::
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -527,7 +527,7 @@ bool load_from_file<material>(core::task_future<asset_handle<material>>& output,
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -599,7 +599,7 @@ bool load_from_file<prefab>(core::task_future<asset_handle<prefab>>& output, con
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -671,7 +671,7 @@ bool load_from_file<scene>(core::task_future<asset_handle<scene>>& output, const
 		return result;
 	};
 
-	auto ready_memory_task = ts.push_on_worker_thread(read_memory_func);
+	auto ready_memory_task = ts.push_on_pool(core::task_pool::io, core::task_priority::normal, read_memory_func);
 	output = ts.push_on_owner_thread(create_resource_func, ready_memory_task);
 	return true;
 }
@@ -37,6 +37,18 @@ void model_component::set_casts_reflection(bool casts_reflection)
 	casts_reflection_ = casts_reflection;
 }
 
+void model_component::set_occluder(bool is_occluder)
+{
+	if(occluder_ == is_occluder)
+	{
+		return;
+	}
+
+	touch();
+
+	occluder_ = is_occluder;
+}
+
 bool model_component::casts_shadow() const
 {
 	return casts_shadow_;
@@ -47,6 +59,11 @@ bool model_component::is_static() const
 	return static_;
 }
 
+bool model_component::is_occluder() const
+{
+	return occluder_;
+}
+
 const model& model_component::get_model() const
 {
 	return model_;
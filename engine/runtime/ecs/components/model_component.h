@@ -55,6 +55,16 @@ public:
 	//-----------------------------------------------------------------------------
 	void set_static(bool is_static);
 
+	//-----------------------------------------------------------------------------
+	//  Name : set_occluder ()
+	/// <summary>
+	/// Occluders are rasterized into the CPU occlusion buffer of every view
+	/// and hide the models behind them. Best kept to a few large and simple
+	/// meshes, walls and floors.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_occluder(bool is_occluder);
+
 	//-----------------------------------------------------------------------------
 	//  Name : casts_shadow ()
 	/// <summary>
@@ -85,6 +95,16 @@ public:
 	//-----------------------------------------------------------------------------
 	bool is_static() const;
 
+	//-----------------------------------------------------------------------------
+	//  Name : is_occluder ()
+	/// <summary>
+	///
+	///
+	///
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool is_occluder() const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_model ()
 	/// <summary>
@@ -121,6 +141,8 @@ private:
 	///
 	bool casts_reflection_ = true;
 	///
+	bool occluder_ = false;
+	///
 	model model_;
 	///
 	std::vector<runtime::entity> bone_entities_;
@@ -1,9 +1,17 @@
 #include "transform_component.h"
 
+#include <core/common/assert.hpp>
 #include <core/logging/logging.h>
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
 
 #include <algorithm>
 
+namespace runtime
+{
+hpp::event<void(entity)> on_transform_parent_changed;
+}
+
 void transform_component::on_entity_set()
 {
 	for(auto& child : children_)
@@ -14,6 +22,7 @@ void transform_component::on_entity_set()
 			if(child_transform)
 			{
 				child_transform->parent_ = get_entity();
+				runtime::on_transform_parent_changed(child);
 			}
 		}
 	}
@@ -356,6 +365,8 @@ void transform_component::set_parent(runtime::entity parent, bool world_position
 		}
 	}
 
+	runtime::on_transform_parent_changed(get_entity());
+
 	if(world_position_stays)
 	{
 		resolve(true);
@@ -365,6 +376,9 @@ void transform_component::set_parent(runtime::entity parent, bool world_position
 	{
 		if(!local_position_stays)
 			set_local_transform(math::transform::identity());
+
+		// the world transform follows the new parent
+		set_dirty(true);
 	}
 
 	set_dirty(is_dirty());
@@ -380,6 +394,14 @@ void transform_component::attach_child(const runtime::entity& child)
 	children_.push_back(child);
 
 	set_dirty(is_dirty());
+	if(is_dirty() && child.valid())
+	{
+		auto child_transform = child.get_component<transform_component>().lock();
+		if(child_transform)
+		{
+			child_transform->set_dirty(true);
+		}
+	}
 }
 
 void transform_component::remove_child(const runtime::entity& child)
@@ -423,8 +445,8 @@ void transform_component::apply_transform(math::transform& trans)
 		auto parent_transform = parent_.get_component<transform_component>().lock();
 		if(parent_transform)
 		{
-			auto inv_parent_transform = math::inverse(parent_transform->get_transform());
-			trans = inv_parent_transform * trans;
+			const auto inv_parent_transform = math::inverse(math::affine3x4(parent_transform->get_transform()));
+			trans = (inv_parent_transform * math::affine3x4(trans)).to_transform();
 		}
 	}
 
@@ -454,12 +476,19 @@ void transform_component::resolve(bool force)
 {
 	if(force || is_dirty())
 	{
+		// Off the owner thread transforms are only read, by systems running
+		// after transform_system resolved them, never written here.
+		expects(!core::has_subsystems<core::task_system>() ||
+				core::get_subsystem<core::task_system>().is_owner_thread());
+
 		if(parent_.valid())
 		{
 			auto parent_transform = parent_.get_component<transform_component>().lock();
 			if(parent_transform)
 			{
-				world_transform_ = parent_transform->get_transform() * local_transform_;
+				const auto& parent_world = parent_transform->get_transform();
+				world_transform_ =
+					(math::affine3x4(parent_world) * math::affine3x4(local_transform_)).to_transform();
 			}
 			else
 			{
@@ -482,12 +511,20 @@ bool transform_component::is_dirty() const
 
 void transform_component::set_dirty(bool dirty)
 {
+	const bool was_dirty = dirty_;
 	dirty_ = dirty;
 
 	if(dirty_ == true)
 	{
 		touch();
 
+		// The children of a dirty transform are always dirty, so there is
+		// nothing to propagate if we already were.
+		if(was_dirty)
+		{
+			return;
+		}
+
 		for(const auto& child : children_)
 		{
 			if(child.valid())
@@ -4,6 +4,11 @@
 
 #include <core/math/math_includes.h>
 
+namespace runtime
+{
+class transform_system;
+}
+
 //-----------------------------------------------------------------------------
 // Main Class Declarations
 //-----------------------------------------------------------------------------
@@ -19,6 +24,7 @@ class transform_component : public runtime::component_impl<transform_component>
 {
 	SERIALIZABLE(transform_component)
 	REFLECTABLEV(transform_component, runtime::component)
+	friend class runtime::transform_system;
 
 public:
 	//-------------------------------------------------------------------------
@@ -50,9 +56,8 @@ public:
 	//-----------------------------------------------------------------------------
 	//  Name : resolve ()
 	/// <summary>
-	///
-	///
-	///
+	/// Computes the world transform of a dirty transform right away, instead
+	/// of waiting for transform_system. Owner thread only.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	void resolve(bool force = false);
@@ -550,3 +555,9 @@ protected:
 	/// Should recalc world transform.
 	bool dirty_ = true;
 };
+
+namespace runtime
+{
+/// Emitted with the child entity whenever the parent of its transform changes.
+extern hpp::event<void(entity)> on_transform_parent_changed;
+}
@@ -7,33 +7,99 @@ namespace ecs
 {
 namespace detail
 {
-frame_getter_t& get_frame_getter()
+std::atomic<change_tick_t>& get_change_counter()
 {
-    static frame_getter_t f;
-    return f;
+    static std::atomic<change_tick_t> counter{0};
+    return counter;
+}
+
+struct frame_ticks
+{
+    /// tick at which the previous frame began
+    std::atomic<change_tick_t> previous_begin{0};
+    /// tick at which the current frame began
+    std::atomic<change_tick_t> current_begin{0};
+};
+
+frame_ticks& get_frame_ticks()
+{
+    static frame_ticks ticks;
+    return ticks;
 }
 } // namespace detail
 
-void set_frame_getter(frame_getter_t frame_getter)
+change_tick_t next_change_tick()
+{
+    return detail::get_change_counter().fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+change_tick_t get_change_tick()
+{
+    return detail::get_change_counter().load(std::memory_order_relaxed);
+}
+
+void begin_frame()
+{
+    auto& ticks = detail::get_frame_ticks();
+    ticks.previous_begin = ticks.current_begin.load();
+    ticks.current_begin = get_change_tick();
+}
+
+bool is_previous_frame_tick(change_tick_t tick)
+{
+    const auto& ticks = detail::get_frame_ticks();
+    return tick > ticks.previous_begin && tick <= ticks.current_begin;
+}
+} // namespace ecs
+
+namespace
+{
+/// Members are sorted again once this fraction of them was added or removed.
+/// A few out of order members cost little while iterating, sorting on every
+/// change would cost more.
+const std::size_t UNSORTED_FRACTION = 8;
+
+bool needs_sort(std::size_t unsorted, std::size_t size)
 {
-    detail::get_frame_getter() = frame_getter;
+    return unsorted > 0 && unsorted * UNSORTED_FRACTION >= size;
 }
 
-uint64_t get_frame()
+/// Sorts the members by descending address of their components, which are
+/// parallel to them, and updates their positions. Descending because views
+/// walk the members from the back.
+void sort_by_address(std::vector<std::uint32_t>& members,
+                     std::vector<component*>& components,
+                     std::vector<std::uint32_t>& positions)
 {
-    const auto& f = detail::get_frame_getter();
-    if(f)
+    std::vector<std::pair<component*, std::uint32_t>> order;
+    order.reserve(members.size());
+    for(std::size_t position = 0; position < members.size(); ++position)
     {
-        return f();
+        order.emplace_back(components[position], members[position]);
+    }
+
+    std::sort(std::begin(order), std::end(order), [](const auto& lhs, const auto& rhs)
+    {
+        return std::greater<component*>()(lhs.first, rhs.first);
+    });
+
+    for(std::size_t position = 0; position < order.size(); ++position)
+    {
+        components[position] = order[position].first;
+        members[position] = order[position].second;
+        positions[members[position]] = static_cast<std::uint32_t>(position);
     }
-    return 0;
 }
-} // namespace ecs
+} // namespace
 
 hpp::event<void(entity)> on_entity_created;
 hpp::event<void(entity)> on_entity_destroyed;
 hpp::event<void(entity, chandle<component>)> on_component_added;
 hpp::event<void(entity, chandle<component>)> on_component_removed;
+hpp::event<void(hpp::span<const entity>)> on_entities_created;
+hpp::event<void(hpp::span<const entity>)> on_entities_destroyed;
+
+const std::uint32_t component_storage::INVALID_POSITION;
 
 component_storage::component_storage(std::size_t size)
 {
@@ -43,11 +109,15 @@ component_storage::component_storage(std::size_t size)
 void component_storage::expand(std::size_t n)
 {
     data.resize(n);
+    pointers_.resize(n, nullptr);
+    positions_.resize(n, INVALID_POSITION);
 }
 
 void component_storage::reserve(std::size_t n)
 {
     data.reserve(n);
+    pointers_.reserve(n);
+    positions_.reserve(n);
 }
 
 std::shared_ptr<component> component_storage::get(std::size_t n) const
@@ -59,16 +129,222 @@ std::shared_ptr<component> component_storage::get(std::size_t n) const
 void component_storage::destroy(std::size_t n)
 {
     expects(n < size());
-    auto& element = data[n];
+    // Unlink first. The component's destructor may reenter the system and
+    // destroy other members of this storage.
+    auto element = std::move(data[n]);
+    pointers_[n] = nullptr;
+    remove_member(static_cast<std::uint32_t>(n));
+    if(element)
+    {
+        unlink(*element);
+    }
+    mark_changed(ecs::next_change_tick());
     element.reset();
 }
 
 std::weak_ptr<component> component_storage::set(unsigned int index, const std::shared_ptr<component>& component)
 {
-    data[index] = component;
+    auto& element = data[index];
+    if(element && element != component)
+    {
+        unlink(*element);
+    }
+    element = component;
+    pointers_[index] = component.get();
+    add_member(index);
+    link(*component);
     return component;
 }
 
+void component_storage::link(component& comp)
+{
+    comp.storage_ = this;
+    // an addition is a change as well
+    comp.touch();
+}
+
+void component_storage::unlink(component& comp)
+{
+    if(comp.storage_ == this)
+    {
+        comp.storage_ = nullptr;
+    }
+}
+
+void component_storage::add_member(std::uint32_t index)
+{
+    if(positions_[index] != INVALID_POSITION)
+    {
+        return;
+    }
+
+    positions_[index] = static_cast<std::uint32_t>(members_.size());
+    members_.push_back(index);
+    ++unsorted_;
+}
+
+void component_storage::remove_member(std::uint32_t index)
+{
+    const auto position = positions_[index];
+    if(position == INVALID_POSITION)
+    {
+        return;
+    }
+
+    // swap and pop
+    const auto last = members_.back();
+    members_[position] = last;
+    positions_[last] = position;
+    members_.pop_back();
+    positions_[index] = INVALID_POSITION;
+    ++unsorted_;
+}
+
+void component_storage::sort_members()
+{
+    if(!needs_sort(unsorted_, members_.size()))
+    {
+        return;
+    }
+
+    std::vector<component*> components;
+    components.reserve(members_.size());
+    for(auto index : members_)
+    {
+        components.emplace_back(pointers_[index]);
+    }
+
+    sort_by_address(members_, components, positions_);
+    unsorted_ = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+entity_component_system::cached_query::cached_query(const component_mask_t& mask) : mask_(mask)
+{
+    for(std::size_t family = 0; family < mask_.size(); ++family)
+    {
+        if(mask_.test(family))
+        {
+            key_family_ = static_cast<rtti::type_index_sequential_t::index_t>(family);
+            break;
+        }
+    }
+}
+
+void entity_component_system::cached_query::add_member(std::uint32_t index, component* key)
+{
+    if(positions_.size() <= index)
+    {
+        positions_.resize(index + 1, component_storage::INVALID_POSITION);
+    }
+    else if(positions_[index] != component_storage::INVALID_POSITION)
+    {
+        key_components_[positions_[index]] = key;
+        return;
+    }
+
+    positions_[index] = static_cast<std::uint32_t>(members_.size());
+    members_.push_back(index);
+    key_components_.push_back(key);
+    ++unsorted_;
+}
+
+void entity_component_system::cached_query::remove_member(std::uint32_t index)
+{
+    if(!contains(index))
+    {
+        return;
+    }
+
+    // swap and pop
+    const auto position = positions_[index];
+    const auto last = members_.back();
+    members_[position] = last;
+    key_components_[position] = key_components_.back();
+    positions_[last] = position;
+    members_.pop_back();
+    key_components_.pop_back();
+    positions_[index] = component_storage::INVALID_POSITION;
+    ++unsorted_;
+}
+
+void entity_component_system::cached_query::clear()
+{
+    members_.clear();
+    key_components_.clear();
+    positions_.clear();
+    unsorted_ = 0;
+}
+
+void entity_component_system::cached_query::sort_members()
+{
+    if(!needs_sort(unsorted_, members_.size()))
+    {
+        return;
+    }
+
+    sort_by_address(members_, key_components_, positions_);
+    unsorted_ = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+const std::uint32_t entity_command_buffer::INVALID_DEFERRED;
+
+entity_command_buffer::deferred_entity entity_command_buffer::create()
+{
+    deferred_entity e;
+    e.index = deferred_count_++;
+    return e;
+}
+
+void entity_command_buffer::destroy(entity e)
+{
+    record(target_t{e, INVALID_DEFERRED}, [](entity e, const entity_command_buffer& /*unused*/) { e.destroy(); });
+}
+
+entity entity_command_buffer::resolve(deferred_entity e) const
+{
+    if(e.index >= created_.size())
+    {
+        return entity();
+    }
+    return created_[e.index];
+}
+
+bool entity_command_buffer::empty() const
+{
+    return commands_.empty() && deferred_count_ == 0;
+}
+
+void entity_command_buffer::record(target_t target, command_t f)
+{
+    commands_.emplace_back();
+    auto& cmd = commands_.back();
+    cmd.target = std::move(target);
+    cmd.f = std::move(f);
+}
+
+void entity_command_buffer::playback(entity_component_system& ecs)
+{
+    created_ = ecs.create_many(deferred_count_);
+
+    for(auto& cmd : commands_)
+    {
+        const auto& target = cmd.target;
+        auto e = target.deferred == INVALID_DEFERRED ? target.e : resolve(deferred_entity{target.deferred});
+        if(!e.valid())
+        {
+            continue;
+        }
+
+        cmd.f(e, *this);
+    }
+
+    commands_.clear();
+    created_.clear();
+    deferred_count_ = 0;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 const entity::id_t entity::INVALID;
 
@@ -152,18 +428,115 @@ const std::string& entity_component_system::get_entity_name(entity::id_t id)
     return entity_names_[id.id()];
 }
 
+void entity_component_system::submit(entity_command_buffer&& buffer)
+{
+    if(buffer.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(submitted_commands_mutex_);
+    submitted_commands_.emplace_back(std::move(buffer));
+}
+
+void entity_component_system::playback_commands()
+{
+    std::vector<entity_command_buffer> buffers;
+    {
+        std::lock_guard<std::mutex> lock(submitted_commands_mutex_);
+        buffers.swap(submitted_commands_);
+    }
+
+    // Buffers submitted while playing back are left for the next sync point.
+    for(auto& buffer : buffers)
+    {
+        buffer.playback(*this);
+    }
+
+    sort_members();
+}
+
+void entity_component_system::sort_members()
+{
+    for(auto& pool : component_pools_)
+    {
+        if(pool)
+        {
+            pool->sort_members();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(queries_mutex_);
+    for(auto& query : queries_)
+    {
+        query->sort_members();
+    }
+}
+
 void entity_component_system::dispose()
 {
+    std::vector<entity> entities;
+    entities.reserve(size());
     for(entity entity : all_entities())
     {
-        entity.destroy();
+        entities.emplace_back(entity);
     }
+    destroy_many(entities);
 
     component_pools_.clear();
     entity_component_mask_.clear();
     entity_version_.clear();
     free_list_.clear();
     index_counter_ = 0;
+    for(auto& query : queries_)
+    {
+        query->clear();
+    }
+}
+
+const entity_component_system::cached_query& entity_component_system::query(const component_mask_t& mask)
+{
+    expects(mask.any() && "A query needs at least one component");
+    std::lock_guard<std::mutex> lock(queries_mutex_);
+    auto it = std::find_if(std::begin(queries_), std::end(queries_), [&mask](const auto& query) {
+        return query->mask() == mask;
+    });
+    if(it != std::end(queries_))
+    {
+        return **it;
+    }
+
+    auto query = std::make_unique<cached_query>(mask);
+    for(auto e : base_view<false>(this, mask))
+    {
+        const auto index = e.id().index();
+        query->add_member(index, component_pools_[query->key_family()]->pointers_[index]);
+    }
+
+    queries_.emplace_back(std::move(query));
+    return *queries_.back();
+}
+
+void entity_component_system::update_queries(std::uint32_t index, rtti::type_index_sequential_t::index_t family)
+{
+    const auto& mask = entity_component_mask_[index];
+    for(auto& query : queries_)
+    {
+        const auto& query_mask = query->mask();
+        if(!query_mask.test(family))
+        {
+            continue;
+        }
+
+        if((mask & query_mask) == query_mask)
+        {
+            query->add_member(index, component_pools_[query->key_family()]->pointers_[index]);
+        }
+        else
+        {
+            query->remove_member(index);
+        }
+    }
 }
 
 void entity_component_system::remove(entity::id_t id, const std::shared_ptr<component>& component)
@@ -182,6 +555,7 @@ void entity_component_system::remove(entity::id_t id, rtti::type_index_sequentia
     on_component_removed(get(id), handle);
     // Remove component bit.
     entity_component_mask_[id.index()].reset(family);
+    update_queries(index, family);
 
     // Call destructor.
     pool->destroy(index);
@@ -252,6 +626,7 @@ chandle<component> entity_component_system::assign(entity::id_t id, const std::s
     auto ptr = pool.set(id.index(), comp);
     // Set the bit for this component.
     entity_component_mask_[id.index()].set(family);
+    update_queries(id.index(), family);
 
     // Create and return handle.
     comp->entity_ = get(id);
@@ -286,6 +661,95 @@ void entity_component_system::destroy(entity::id_t id)
     free_list_.push_back(index);
 }
 
+std::vector<entity> entity_component_system::create_many(std::size_t n)
+{
+    std::vector<entity> entities;
+    entities.reserve(n);
+
+    // Take the free slots from the back, the same order create() uses.
+    auto reused = std::min(n, free_list_.size());
+    for(std::size_t i = 0; i < reused; ++i)
+    {
+        auto index = free_list_[free_list_.size() - 1 - i];
+        entities.emplace_back(this, entity::id_t(index, entity_version_[index]));
+    }
+    free_list_.resize(free_list_.size() - reused);
+
+    auto fresh = static_cast<std::uint32_t>(n - reused);
+    if(fresh > 0)
+    {
+        auto first = index_counter_;
+        index_counter_ += fresh;
+        accomodate_entity(index_counter_ - 1);
+        for(auto index = first; index < index_counter_; ++index)
+        {
+            entity_version_[index] = 1;
+            entities.emplace_back(this, entity::id_t(index, 1));
+        }
+    }
+
+    if(!entities.empty())
+    {
+        on_entities_created(entities);
+    }
+    return entities;
+}
+
+void entity_component_system::destroy_many(hpp::span<const entity> entities)
+{
+    std::vector<entity> destroyed;
+    destroyed.reserve(entities.size());
+    for(const auto& e : entities)
+    {
+        // Removing a component may cascade and destroy other entities of the
+        // batch (e.g. the children of a transform).
+        if(!e.valid())
+        {
+            continue;
+        }
+
+        auto index = e.id().index();
+        auto mask = entity_component_mask_[index];
+        for(size_t i = 0; i < component_pools_.size(); ++i)
+        {
+            if(mask.test(i))
+            {
+                auto& pool = component_pools_[i];
+                if(pool)
+                {
+                    auto handle = pool->get(index);
+                    handle->entity_.remove(handle);
+                }
+            }
+        }
+        destroyed.emplace_back(e);
+    }
+
+    destroyed.erase(std::remove_if(std::begin(destroyed),
+                                   std::end(destroyed),
+                                   [](const entity& e) { return !e.valid(); }),
+                    std::end(destroyed));
+    // The same entity may be passed more than once.
+    std::sort(std::begin(destroyed), std::end(destroyed));
+    destroyed.erase(std::unique(std::begin(destroyed), std::end(destroyed)), std::end(destroyed));
+    if(destroyed.empty())
+    {
+        return;
+    }
+
+    on_entities_destroyed(destroyed);
+
+    free_list_.reserve(free_list_.size() + destroyed.size());
+    for(const auto& e : destroyed)
+    {
+        auto id = e.id();
+        entity_names_.erase(id.id());
+        entity_component_mask_[id.index()].reset();
+        entity_version_[id.index()]++;
+        free_list_.push_back(id.index());
+    }
+}
+
 entity entity_component_system::get(entity::id_t id)
 {
     assert_valid(id);
@@ -3,13 +3,19 @@
 #pragma once
 
 #include <core/common/assert.hpp>
+#include <core/common/hpp/span.hpp>
 #include <core/common/hpp/type_index.hpp>
+#include <core/common/hpp/utility/apply.hpp>
+#include <core/memory/paged_pool.h>
 #include <core/reflection/registration.h>
 #include <core/serialization/serialization.h>
 #include <core/signals/event.hpp>
+#include <core/tasks/task_system.h>
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
@@ -23,6 +29,7 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -31,18 +38,45 @@ namespace runtime
 
 namespace ecs
 {
-using frame_getter_t = std::function<std::uint64_t()>;
-void set_frame_getter(frame_getter_t frame_getter);
-std::uint64_t get_frame();
+/// Change ticks are issued from a single, monotonically increasing counter.
+/// Every component and every component pool remembers the tick of its last
+/// change, so a pass can remember get_change_tick() and later ask for
+/// anything that changed after it, regardless of how many frames passed.
+using change_tick_t = std::uint64_t;
+
+/// Issues a new change tick, greater than every tick issued before.
+change_tick_t next_change_tick();
+
+/// Returns the most recently issued change tick.
+change_tick_t get_change_tick();
+
+/// Marks the start of a new frame. Should be called once per frame.
+void begin_frame();
+
+/// Returns true if the tick was issued during the previous frame.
+bool is_previous_frame_tick(change_tick_t tick);
 } // namespace ecs
 
 template<typename C>
 using chandle = std::weak_ptr<C>;
 
 class component;
+
+/// Storage for all components of a single family. Components created
+/// through the storage are allocated from a paged pool owned by the family
+/// so they are packed next to each other in memory instead of being
+/// scattered across the heap.
+/// The storage is also a sparse set. Besides the per entity slots it keeps a
+/// dense list with the indices of the entities that own a component of this
+/// family, so views can visit only the members instead of every entity.
+/// Components stay where they were allocated since handles point at them, so
+/// instead the member list is kept in address order (see sort_members) and
+/// walking it walks the pool pages front to back.
 class component_storage
 {
 public:
+    static const std::uint32_t INVALID_POSITION = ~std::uint32_t(0);
+
     component_storage(std::size_t size = 100);
 
     inline std::size_t size() const
@@ -66,20 +100,103 @@ public:
         return std::static_pointer_cast<T>(get(n));
     }
 
+    /// Raw access to a stored component without touching its reference
+    /// count. The slot must be occupied.
+    template<typename T>
+    T& get_ref(std::size_t n) const
+    {
+        static_assert(std::is_base_of<component, T>::value, "Invalid component type.");
+        assert(n < size() && pointers_[n] && "Accessing an empty component slot");
+
+        return static_cast<T&>(*pointers_[n]);
+    }
+
     void destroy(std::size_t n);
 
+    /// Creates a component inside the family's paged pool. The component and
+    /// its reference count share a single pool block.
+    template<typename T, typename... Args>
+    std::shared_ptr<T> make(Args&&... args)
+    {
+        static_assert(std::is_base_of<component, T>::value, "Invalid component type.");
+
+        return std::allocate_shared<T>(memory::pool_allocator<T>(pool_), std::forward<Args>(args)...);
+    }
+
     template<typename T, typename... Args>
     std::weak_ptr<T> set(unsigned int index, Args&&... args)
     {
-        auto element = std::make_shared<T>(std::forward<Args>(args)...);
-        data[index] = std::move(element);
-        return std::static_pointer_cast<T>(data[index]);
+        return std::static_pointer_cast<T>(set(index, make<T>(std::forward<Args>(args)...)).lock());
     }
 
     std::weak_ptr<component> set(unsigned int index, const std::shared_ptr<component>& component);
 
+    const memory::paged_pool& get_pool() const
+    {
+        return *pool_;
+    }
+
+    /// Records a change of a member. Safe to call concurrently.
+    inline void mark_changed(ecs::change_tick_t tick)
+    {
+        auto last = last_changed_.load(std::memory_order_relaxed);
+        while(last < tick && !last_changed_.compare_exchange_weak(last, tick, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// Tick of the last change of any member, including additions and removals.
+    inline ecs::change_tick_t get_last_changed() const
+    {
+        return last_changed_.load(std::memory_order_relaxed);
+    }
+
+    inline bool changed_since(ecs::change_tick_t tick) const
+    {
+        return get_last_changed() > tick;
+    }
+
+    /// Indices of the entities that own a component of this family.
+    /// The order is unspecified.
+    inline const std::vector<std::uint32_t>& members() const
+    {
+        return members_;
+    }
+
+    inline bool contains(std::size_t n) const
+    {
+        return n < positions_.size() && positions_[n] != INVALID_POSITION;
+    }
+
 private:
+    friend class entity_component_system;
+
+    void add_member(std::uint32_t index);
+    void remove_member(std::uint32_t index);
+
+    /// Orders members_ by descending component address, views walk it from
+    /// the back so they visit the pool in address order. Only sorts once
+    /// enough members were added or removed since the last time.
+    void sort_members();
+
+    void link(component& comp);
+    void unlink(component& comp);
+
     std::vector<std::shared_ptr<component>> data;
+    /// Same as data without the reference count, so views read a dense
+    /// array of plain pointers.
+    std::vector<component*> pointers_;
+    /// Tick of the last change of any member.
+    std::atomic<ecs::change_tick_t> last_changed_{0};
+    /// Dense list of member entity indices.
+    std::vector<std::uint32_t> members_;
+    /// Position of each entity index inside members_ or INVALID_POSITION.
+    std::vector<std::uint32_t> positions_;
+    /// Members added or removed since members_ was last sorted.
+    std::size_t unsorted_ = 0;
+    /// Backing memory for the components of this family. Shared with every
+    /// component allocated from it so it outlives the storage if needed.
+    std::shared_ptr<memory::paged_pool> pool_ = std::make_shared<memory::paged_pool>();
 };
 
 class entity_component_system;
@@ -247,6 +364,7 @@ class component : public std::enable_shared_from_this<component>
     REFLECTABLEV(component)
     SERIALIZABLE(component)
     friend class entity_component_system;
+    friend class component_storage;
 
 public:
     //-----------------------------------------------------------------------------
@@ -295,7 +413,11 @@ public:
     //-----------------------------------------------------------------------------
     void touch()
     {
-        last_touched_ = static_cast<std::uint32_t>(ecs::get_frame());
+        last_touched_ = ecs::next_change_tick();
+        if(storage_)
+        {
+            storage_->mark_changed(last_touched_);
+        }
     }
 
     //-----------------------------------------------------------------------------
@@ -308,7 +430,29 @@ public:
     //-----------------------------------------------------------------------------
     bool is_touched() const
     {
-        return last_touched_ == static_cast<std::uint32_t>(ecs::get_frame()) - 1;
+        return ecs::is_previous_frame_tick(last_touched_);
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : changed_since ()
+    /// <summary>
+    /// Was the component touched after the given change tick.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    bool changed_since(ecs::change_tick_t tick) const
+    {
+        return last_touched_ > tick;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_last_touched ()
+    /// <summary>
+    /// Change tick of the last touch.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    ecs::change_tick_t get_last_touched() const
+    {
+        return last_touched_;
     }
 
     //-----------------------------------------------------------------------------
@@ -346,10 +490,14 @@ protected:
     /// </summary>
     //-----------------------------------------------------------------------------
     virtual rtti::type_index_sequential_t::index_t runtime_id() const = 0;
-    /// Was the component touched.
-    std::uint32_t last_touched_ = 0;
+    /// Change tick of the last touch.
+    ecs::change_tick_t last_touched_ = 0;
     /// Owning entity
     entity entity_;
+
+private:
+    /// Pool the component lives in, if any.
+    component_storage* storage_ = nullptr;
 };
 
 template<typename T>
@@ -381,6 +529,140 @@ extern hpp::event<void(entity)> on_entity_created;
 extern hpp::event<void(entity)> on_entity_destroyed;
 extern hpp::event<void(entity, chandle<component>)> on_component_added;
 extern hpp::event<void(entity, chandle<component>)> on_component_removed;
+// Emitted once per create_many/destroy_many call instead of the per entity
+// events above.
+extern hpp::event<void(hpp::span<const entity>)> on_entities_created;
+extern hpp::event<void(hpp::span<const entity>)> on_entities_destroyed;
+
+/**
+ * Records structural changes (create, assign, remove, destroy) so they can
+ * be applied later on the thread that owns the entity_component_system.
+ *
+ * A buffer is not meant to be shared between threads. Each thread records
+ * into its own buffer without any locking and hands it over with
+ * entity_component_system::submit(). Submitted buffers are played back in
+ * submission order by entity_component_system::playback_commands().
+ *
+ * @code
+ * entity_command_buffer cmd;
+ * auto e = cmd.create();
+ * cmd.assign<Position>(e, 1.0f, 2.0f);
+ * ecs.submit(std::move(cmd));
+ * @endcode
+ */
+class entity_command_buffer
+{
+public:
+    /// Placeholder for an entity that will be created on playback.
+    struct deferred_entity
+    {
+        std::uint32_t index = 0;
+    };
+
+    /// Custom command. Receives the target entity and the buffer being played
+    /// back, which can resolve deferred entities.
+    using command_t = std::function<void(entity, const entity_command_buffer&)>;
+
+    /**
+     * Record the creation of an entity.
+     */
+    deferred_entity create();
+
+    /**
+     * Record the destruction of an entity.
+     */
+    void destroy(entity e);
+
+    /**
+     * Record the assignment of a component, passing through component
+     * constructor arguments. Arguments are copied into the buffer.
+     */
+    template<typename C, typename... Args>
+    void assign(entity e, Args&&... args)
+    {
+        record(target_t{e, INVALID_DEFERRED}, make_assign<C>(std::forward<Args>(args)...));
+    }
+
+    template<typename C, typename... Args>
+    void assign(deferred_entity e, Args&&... args)
+    {
+        record(target_t{entity(), e.index}, make_assign<C>(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Record the removal of a component.
+     */
+    template<typename C>
+    void remove(entity e)
+    {
+        record(target_t{e, INVALID_DEFERRED}, [](entity e, const entity_command_buffer& /*unused*/) {
+            if(e.has_component<C>())
+            {
+                e.remove<C>();
+            }
+        });
+    }
+
+    /**
+     * Record a custom command called as f(entity, const entity_command_buffer&).
+     */
+    void invoke(entity e, command_t f)
+    {
+        record(target_t{e, INVALID_DEFERRED}, std::move(f));
+    }
+
+    void invoke(deferred_entity e, command_t f)
+    {
+        record(target_t{entity(), e.index}, std::move(f));
+    }
+
+    /**
+     * Entity created for a deferred entity. Only valid during playback.
+     */
+    entity resolve(deferred_entity e) const;
+
+    bool empty() const;
+
+    /**
+     * Create the deferred entities, apply the recorded commands in order and
+     * clear the buffer. Commands targeting entities that are no longer valid
+     * are skipped.
+     */
+    void playback(entity_component_system& ecs);
+
+private:
+    static const std::uint32_t INVALID_DEFERRED = ~std::uint32_t(0);
+
+    struct target_t
+    {
+        entity e;
+        std::uint32_t deferred = INVALID_DEFERRED;
+    };
+
+    struct command
+    {
+        target_t target;
+        command_t f;
+    };
+
+    template<typename C, typename... Args>
+    static command_t make_assign(Args&&... args)
+    {
+        auto params = std::make_tuple(std::forward<Args>(args)...);
+        return [params](entity e, const entity_command_buffer& /*unused*/) {
+            hpp::apply([&e](const auto&... a) { e.template assign<C>(a...); }, params);
+        };
+    }
+
+    void record(target_t target, command_t f);
+
+    /// recorded commands in order
+    std::vector<command> commands_;
+    /// number of entities to be created
+    std::uint32_t deferred_count_ = 0;
+    /// entities created during playback
+    std::vector<entity> created_;
+};
 
 /**
  * Manages entity::Id creation and component assignment.
@@ -393,26 +675,98 @@ public:
 
     explicit entity_component_system() = default;
     virtual ~entity_component_system();
+
+    /// Persistent query over the entities having all the components of its
+    /// mask. The matching entity indices are kept up to date by assign, remove
+    /// and destroy, so iterating a query does not test any masks.
+    /// Next to each member the query keeps its component of the key family
+    /// (the lowest family of the mask), so iterating reads that component
+    /// from a dense array in pool address order instead of looking it up by
+    /// entity index.
+    class cached_query
+    {
+    public:
+        explicit cached_query(const component_mask_t& mask);
+
+        const component_mask_t& mask() const
+        {
+            return mask_;
+        }
+
+        /// Dense list of the matching entity indices, in no particular order.
+        const std::vector<std::uint32_t>& members() const
+        {
+            return members_;
+        }
+
+        rtti::type_index_sequential_t::index_t key_family() const
+        {
+            return key_family_;
+        }
+
+        /// Components of the key family, parallel to members().
+        const std::vector<component*>& key_components() const
+        {
+            return key_components_;
+        }
+
+        std::size_t size() const
+        {
+            return members_.size();
+        }
+
+        bool contains(std::uint32_t index) const
+        {
+            return index < positions_.size() && positions_[index] != component_storage::INVALID_POSITION;
+        }
+
+    private:
+        friend class entity_component_system;
+
+        /// Adds the entity or, if it already is a member, refreshes its
+        /// key component which may have been replaced.
+        void add_member(std::uint32_t index, component* key);
+        void remove_member(std::uint32_t index);
+        void clear();
+        /// Same as component_storage::sort_members, by the key components.
+        void sort_members();
+
+        component_mask_t mask_;
+        rtti::type_index_sequential_t::index_t key_family_ = 0;
+        /// Dense list of member entity indices.
+        std::vector<std::uint32_t> members_;
+        /// Key family component of each member.
+        std::vector<component*> key_components_;
+        /// Position of each entity index inside members_.
+        std::vector<std::uint32_t> positions_;
+        /// Members added or removed since members_ was last sorted.
+        std::size_t unsorted_ = 0;
+    };
+
     /// An iterator over a view of the entities in an entity_component_system.
     /// If All is true it will iterate over all valid entities and will ignore the
-    /// entity mask.
+    /// entity mask. Otherwise it walks the member list of the smallest pool
+    /// referenced by the mask (the driver) and tests only those entities, so
+    /// the cost scales with the matching set rather than the world size.
+    /// The driver is walked from the back, which makes it safe to remove the
+    /// current entity's components or destroy it while iterating.
     template<class Delegate, bool All = false>
     class view_iterator : public std::iterator<std::input_iterator_tag, entity::id_t>
     {
     public:
         Delegate& operator++()
         {
-            ++i_;
+            step();
             next();
             return *static_cast<Delegate*>(this);
         }
         bool operator==(const Delegate& rhs) const
         {
-            return i_ == rhs.i_;
+            return cursor_ == rhs.cursor_;
         }
         bool operator!=(const Delegate& rhs) const
         {
-            return i_ != rhs.i_;
+            return cursor_ != rhs.cursor_;
         }
         entity operator*()
         {
@@ -424,9 +778,14 @@ public:
         }
 
     protected:
-        view_iterator(entity_component_system* manager, std::uint32_t index)
+        view_iterator(entity_component_system* manager,
+                      const component_mask_t mask,
+                      const component_storage* driver,
+                      std::size_t cursor)
             : manager_(manager)
-            , i_(index)
+            , driver_(driver)
+            , mask_(mask)
+            , cursor_(cursor)
             , capacity_(manager_->capacity())
             , free_cursor_(~0UL)
         {
@@ -436,32 +795,63 @@ public:
                 free_cursor_ = 0;
             }
         }
-        view_iterator(entity_component_system* manager, const component_mask_t mask, std::uint32_t index)
-            : manager_(manager)
-            , mask_(mask)
-            , i_(index)
-            , capacity_(manager_->capacity())
-            , free_cursor_(~0UL)
+
+        void next()
+        {
+            while(fetch() && !predicate())
+            {
+                step();
+            }
+
+            if(!at_end())
+            {
+                entity entity = manager_->get(manager_->create_id(i_));
+                static_cast<Delegate*>(this)->next_entity(entity);
+            }
+        }
+
+        inline bool at_end() const
+        {
+            return All ? cursor_ >= capacity_ : cursor_ == 0;
+        }
+
+        inline void step()
         {
             if(All)
             {
-                std::sort(manager_->free_list_.begin(), manager_->free_list_.end());
-                free_cursor_ = 0;
+                ++cursor_;
+            }
+            else if(cursor_ > 0)
+            {
+                --cursor_;
             }
         }
 
-        void next()
+        /// Resolves the entity index under the cursor. Returns false at the end.
+        inline bool fetch()
         {
-            while(i_ < capacity_ && !predicate())
+            if(All)
             {
-                ++i_;
+                i_ = static_cast<std::uint32_t>(cursor_);
+                return !at_end();
             }
 
-            if(i_ < capacity_)
+            // No driver when a family in the mask has no pool, nothing matches.
+            if(!driver_)
             {
-                entity entity = manager_->get(manager_->create_id(i_));
-                static_cast<Delegate*>(this)->next_entity(entity);
+                cursor_ = 0;
+                return false;
+            }
+
+            // The driver may have shrunk while iterating.
+            const auto& members = driver_->members();
+            cursor_ = std::min(cursor_, members.size());
+            if(at_end())
+            {
+                return false;
             }
+            i_ = members[cursor_ - 1];
+            return true;
         }
 
         inline bool predicate()
@@ -472,17 +862,18 @@ public:
         inline bool valid_entity()
         {
             const std::vector<std::uint32_t>& free_list = manager_->free_list_;
-            if(free_cursor_ < free_list.size() && free_list[free_cursor_] == i_)
+            while(free_cursor_ < free_list.size() && free_list[free_cursor_] < i_)
             {
                 ++free_cursor_;
-                return false;
             }
-            return true;
+            return !(free_cursor_ < free_list.size() && free_list[free_cursor_] == i_);
         }
 
         entity_component_system* manager_;
+        const component_storage* driver_;
         component_mask_t mask_;
-        std::uint32_t i_;
+        std::uint32_t i_ = 0;
+        std::size_t cursor_;
         size_t capacity_;
         size_t free_cursor_;
     };
@@ -494,8 +885,11 @@ public:
         class iterator_type : public view_iterator<iterator_type, All>
         {
         public:
-            iterator_type(entity_component_system* manager, const component_mask_t mask, std::uint32_t index)
-                : view_iterator<iterator_type, All>(manager, mask, index)
+            iterator_type(entity_component_system* manager,
+                          const component_mask_t mask,
+                          const component_storage* driver,
+                          std::size_t cursor)
+                : view_iterator<iterator_type, All>(manager, mask, driver, cursor)
             {
                 view_iterator<iterator_type, All>::next();
             }
@@ -507,55 +901,114 @@ public:
 
         iterator_type begin()
         {
-            return iterator_type(manager_, mask_, 0);
+            return iterator_type(manager_, mask_, driver_, begin_cursor());
         }
         iterator_type end()
         {
-            return iterator_type(manager_, mask_, std::uint32_t(manager_->capacity()));
+            return iterator_type(manager_, mask_, driver_, end_cursor());
         }
         const iterator_type begin() const
         {
-            return iterator_type(manager_, mask_, 0);
+            return iterator_type(manager_, mask_, driver_, begin_cursor());
         }
         const iterator_type end() const
         {
-            return iterator_type(manager_, mask_, manager_->capacity());
+            return iterator_type(manager_, mask_, driver_, end_cursor());
+        }
+
+    protected:
+        std::size_t begin_cursor() const
+        {
+            if(All)
+            {
+                return 0;
+            }
+            return driver_ ? driver_->members().size() : 0;
+        }
+
+        std::size_t end_cursor() const
+        {
+            return All ? manager_->capacity() : 0;
         }
 
-    private:
         friend class entity_component_system;
 
         explicit base_view(entity_component_system* manager) : manager_(manager)
         {
             mask_.set();
         }
-        base_view(entity_component_system* manager, component_mask_t mask) : manager_(manager), mask_(mask)
+        base_view(entity_component_system* manager, component_mask_t mask)
+            : manager_(manager)
+            , mask_(mask)
+            , driver_(All ? nullptr : manager->get_driver(mask))
         {
         }
 
         entity_component_system* manager_;
         component_mask_t mask_;
+        const component_storage* driver_ = nullptr;
     };
 
     template<bool All, typename... Components>
     class typed_view : public base_view<All>
     {
     public:
-        template<typename T>
-        struct identity
+        /// Calls f(entity, Components&...) for every entity in the view.
+        /// Components are handed out as references straight from their pools.
+        template<typename F>
+        void for_each(F&& f)
         {
-            using type = T;
-        };
+            for_each_impl(f, std::index_sequence_for<Components...>());
+        }
 
-        void for_each(typename identity<std::function<void(entity entity, Components&...)>>::type f)
+        /// Same as for_each, but only visits entities for which at least one
+        /// of the Components changed after 'since'. Returns immediately if
+        /// none of the pools changed.
+        template<typename F>
+        void for_each_changed(ecs::change_tick_t since, F&& f)
         {
-            for(auto it : *this)
+            for_each_changed_impl(since, f, std::index_sequence_for<Components...>());
+        }
+
+    private:
+        template<typename F, std::size_t... I>
+        void for_each_changed_impl(ecs::change_tick_t since, F& f, std::index_sequence<I...> /*unused*/)
+        {
+            auto manager = this->manager_;
+            const component_storage* const pools[] = {manager->template get_storage<Components>()...};
+            const bool any_pool_changed = std::any_of(std::begin(pools), std::end(pools), [since](const auto pool) {
+                return pool && pool->changed_since(since);
+            });
+            if(!any_pool_changed)
             {
-                f(it, *(it.template get_component<Components>().lock().get())...);
+                return;
+            }
+
+            for(auto e : *this)
+            {
+                assert(manager->valid(e.id()) && "Iterating a dead entity");
+                const auto index = e.id().index();
+                const bool changed[] = {pools[I]->template get_ref<Components>(index).changed_since(since)...};
+                if(std::any_of(std::begin(changed), std::end(changed), [](bool c) { return c; }))
+                {
+                    f(e, pools[I]->template get_ref<Components>(index)...);
+                }
+            }
+        }
+
+        template<typename F, std::size_t... I>
+        void for_each_impl(F& f, std::index_sequence<I...> /*unused*/)
+        {
+            auto manager = this->manager_;
+            const component_storage* const pools[] = {manager->template get_storage<Components>()...};
+            for(auto e : *this)
+            {
+                assert(manager->valid(e.id()) && "Iterating a dead entity");
+                const auto index = e.id().index();
+                f(e, pools[I]->template get_ref<Components>(index)...);
             }
         }
 
-    private:
         friend class entity_component_system;
 
         explicit typed_view(entity_component_system* manager) : base_view<All>(manager)
@@ -607,9 +1060,10 @@ public:
         public:
             iterator_type(entity_component_system* manager,
                           const component_mask_t mask,
-                          std::uint32_t index,
+                          const component_storage* driver,
+                          std::size_t cursor,
                           const unpacker& unpacker)
-                : view_iterator<iterator_type>(manager, mask, index)
+                : view_iterator<iterator_type>(manager, mask, driver, cursor)
                 , unpacker_(unpacker)
             {
                 view_iterator<iterator_type>::next();
@@ -626,19 +1080,19 @@ public:
 
         iterator_type begin()
         {
-            return iterator_type(manager_, mask_, 0, unpacker_);
+            return iterator_type(manager_, mask_, driver_, begin_cursor(), unpacker_);
         }
         iterator_type end()
         {
-            return iterator_type(manager_, mask_, static_cast<std::uint32_t>(manager_->capacity()), unpacker_);
+            return iterator_type(manager_, mask_, driver_, 0, unpacker_);
         }
         const iterator_type begin() const
         {
-            return iterator_type(manager_, mask_, 0, unpacker_);
+            return iterator_type(manager_, mask_, driver_, begin_cursor(), unpacker_);
         }
         const iterator_type end() const
         {
-            return iterator_type(manager_, mask_, static_cast<std::uint32_t>(manager_->capacity()), unpacker_);
+            return iterator_type(manager_, mask_, driver_, 0, unpacker_);
         }
 
     private:
@@ -647,12 +1101,19 @@ public:
         unpacking_view(entity_component_system* manager, component_mask_t mask, chandle<Components>&... handles)
             : manager_(manager)
             , mask_(mask)
+            , driver_(manager->get_driver(mask))
             , unpacker_(handles...)
         {
         }
 
+        std::size_t begin_cursor() const
+        {
+            return driver_ ? driver_->members().size() : 0;
+        }
+
         entity_component_system* manager_;
         component_mask_t mask_;
+        const component_storage* driver_ = nullptr;
         unpacker unpacker_;
     };
 
@@ -689,6 +1150,22 @@ public:
      */
     void destroy(entity::id_t id);
 
+    /**
+     * Create n entities at once. Free slots are reused in bulk and the
+     * component pools are resized at most once.
+     *
+     * Emits a single on_entities_created event.
+     */
+    std::vector<entity> create_many(std::size_t n);
+
+    /**
+     * Destroy a batch of entities and their associated Components. Entities
+     * which are already invalid are skipped.
+     *
+     * Emits a single on_entities_destroyed event.
+     */
+    void destroy_many(hpp::span<const entity> entities);
+
     entity get(entity::id_t id);
 
     /**
@@ -710,7 +1187,8 @@ public:
     template<typename C, typename... Args>
     chandle<C> assign(entity::id_t id, Args&&... args)
     {
-        return std::static_pointer_cast<C>(assign(id, std::make_shared<C>(std::forward<Args>(args)...)).lock());
+        auto comp = accomodate_component<C>().template make<C>(std::forward<Args>(args)...);
+        return std::static_pointer_cast<C>(assign(id, comp).lock());
     }
 
     chandle<component> assign(entity::id_t id, const std::shared_ptr<component>& comp);
@@ -793,18 +1271,114 @@ public:
         return view<Components...>(this, mask);
     }
 
-    template<typename T>
-    struct identity
+    /**
+     * Call f(entity, Components&...) for every entity that has all of the
+     * specified Components. The callable is inlined and the components are
+     * passed by reference straight from their pools.
+     *
+     * @code
+     * ecs.for_each<Position, Direction>([](entity e, Position& p, Direction& d) {});
+     * @endcode
+     */
+    template<typename... Components, typename F>
+    void for_each(F&& f)
     {
-        using type = T;
-    };
+        for_each_impl<Components...>(query<Components...>(), f, std::index_sequence_for<Components...>());
+    }
 
-    template<typename... Components>
-    void for_each(typename identity<std::function<void(entity e, Components&...)>>::type f)
+    /**
+     * Same as for_each, but only visits entities for which at least one of
+     * the specified Components was touched after the 'since' change tick.
+     *
+     * @code
+     * auto since = last_tick;
+     * last_tick = ecs::get_change_tick();
+     * ecs.for_each_changed<Position>(since, [](entity e, Position& p) {});
+     * @endcode
+     */
+    template<typename... Components, typename F>
+    void for_each_changed(ecs::change_tick_t since, F&& f)
+    {
+        for_each_changed_impl<Components...>(
+            query<Components...>(), since, f, std::index_sequence_for<Components...>());
+    }
+
+    /**
+     * Same as for_each, but the matching entities are split into chunks of
+     * at most 'grain_size' entities which are processed by the task_system
+     * workers, see task_system::parallel_for. The calling thread helps and the
+     * call returns once every chunk is done. The first exception thrown by 'f'
+     * is rethrown here.
+     * Work the frame waits on should pass core::task_priority::frame_critical.
+     *
+     * 'f' is invoked concurrently, so it must not create, destroy, assign or
+     * remove anything and must only touch data owned by the entity it is
+     * given.
+     *
+     * @code
+     * ecs.parallel_for_each<Position, Velocity>(tasks, [](entity e, Position& p, Velocity& v) {
+     *   p.value += v.value;
+     * });
+     * @endcode
+     */
+    template<typename... Components, typename F>
+    void parallel_for_each(core::task_system& tasks, F&& f, std::size_t grain_size = 64,
+                           core::task_priority priority = core::task_priority::normal)
+    {
+        const auto& members = query<Components...>().members();
+        std::vector<entity> matching;
+        matching.reserve(members.size());
+        for(auto index : members)
+        {
+            matching.emplace_back(this, create_id(index));
+        }
+
+        if(matching.empty())
+        {
+            return;
+        }
+
+        const auto process = [this, &matching, &f](std::size_t begin, std::size_t end) {
+            for(std::size_t i = begin; i < end; ++i)
+            {
+                const auto& e = matching[i];
+                const auto index = e.id().index();
+                f(e, get_storage<Components>()->template get_ref<Components>(index)...);
+            }
+        };
+
+        tasks.parallel_for(0, matching.size(), grain_size, process, priority);
+    }
+
+    /**
+     * Return true if any component of type C was touched, assigned or
+     * removed after the 'since' change tick.
+     */
+    template<typename C>
+    bool changed_since(ecs::change_tick_t since) const
     {
-        return entities_with_components<Components...>().for_each(f);
+        auto pool = get_storage<C>();
+        return pool && pool->changed_since(since);
     }
 
+    /**
+     * Returns the persistent query for the specified Components, registering
+     * it on first use. The for_each family of functions goes through it.
+     * Safe to call from the systems running concurrently, as long as nothing
+     * is created, destroyed, assigned or removed meanwhile.
+     *
+     * @code
+     * for (auto index : ecs.query<Position, Direction>().members()) {}
+     * @endcode
+     */
+    template<typename C, typename... Components>
+    const cached_query& query()
+    {
+        return query(component_mask<C, Components...>());
+    }
+
+    const cached_query& query(const component_mask_t& mask);
+
     /**
      * Find Entities that have all of the specified Components and assign them
      * to the given parameters.
@@ -864,6 +1438,21 @@ public:
         unpack<Args...>(id, args...);
     }
 
+    /**
+     * Hand over a command buffer recorded on any thread. It will be played
+     * back by the next playback_commands() call. Thread safe.
+     */
+    void submit(entity_command_buffer&& buffer);
+
+    /**
+     * Play back every submitted command buffer in submission order. This is
+     * the sync point for structural changes recorded by other threads and
+     * must be called from the thread that owns the system. Afterwards the
+     * member lists that drifted out of component address order are sorted
+     * again, so nothing may iterate the system meanwhile.
+     */
+    void playback_commands();
+
     /**
      * Destroy all entities and reset the entity_component_system.
      */
@@ -881,6 +1470,107 @@ private:
         expects(entity_version_[id.index()] == id.version() && "Attempt to access entity via a stale entity::Id");
     }
 
+    /// Walks the members from the back and clamps the cursor to the current
+    /// size, so 'f' may remove the current entity's components or destroy it.
+    template<typename... Components, typename F, std::size_t... I>
+    void for_each_impl(const cached_query& query, F& f, std::index_sequence<I...> /*unused*/)
+    {
+        const auto& members = query.members();
+        const auto& keys = query.key_components();
+        const component_storage* const pools[] = {get_storage<Components>()...};
+        const bool is_key[] = {rtti::type_index_sequential_t::id<component, Components>() == query.key_family()...};
+        for(std::size_t cursor = members.size(); cursor > 0; cursor = std::min(cursor - 1, members.size()))
+        {
+            const auto index = members[cursor - 1];
+            f(entity(this, create_id(index)),
+              get_member<Components>(pools[I], is_key[I] ? keys[cursor - 1] : nullptr, index)...);
+        }
+    }
+
+    /// The component of a query member, straight from the query's key
+    /// components when 'key' is given, otherwise from its storage.
+    template<typename C>
+    static C& get_member(const component_storage* pool, component* key, std::uint32_t index)
+    {
+        return key ? static_cast<C&>(*key) : pool->template get_ref<C>(index);
+    }
+
+    template<typename... Components, typename F, std::size_t... I>
+    void for_each_changed_impl(const cached_query& query,
+                               ecs::change_tick_t since,
+                               F& f,
+                               std::index_sequence<I...> /*unused*/)
+    {
+        const component_storage* const pools[] = {get_storage<Components>()...};
+        const bool any_pool_changed = std::any_of(std::begin(pools), std::end(pools), [since](const auto pool) {
+            return pool && pool->changed_since(since);
+        });
+        if(!any_pool_changed)
+        {
+            return;
+        }
+
+        const auto& members = query.members();
+        const auto& keys = query.key_components();
+        const bool is_key[] = {rtti::type_index_sequential_t::id<component, Components>() == query.key_family()...};
+        for(std::size_t cursor = members.size(); cursor > 0; cursor = std::min(cursor - 1, members.size()))
+        {
+            const auto index = members[cursor - 1];
+            const auto key = keys[cursor - 1];
+            const bool changed[] = {
+                get_member<Components>(pools[I], is_key[I] ? key : nullptr, index).changed_since(since)...};
+            if(std::any_of(std::begin(changed), std::end(changed), [](bool c) { return c; }))
+            {
+                f(entity(this, create_id(index)), get_member<Components>(pools[I], is_key[I] ? key : nullptr, index)...);
+            }
+        }
+    }
+
+    /// Adds or removes the entity from the queries referencing 'family' after
+    /// its component mask changed.
+    void update_queries(std::uint32_t index, rtti::type_index_sequential_t::index_t family);
+
+    /// Puts the member lists of the storages and queries back in component
+    /// address order.
+    void sort_members();
+
+    template<typename C>
+    const component_storage* get_storage() const
+    {
+        auto family = rtti::type_index_sequential_t::id<component, C>();
+        if(family >= component_pools_.size())
+        {
+            return nullptr;
+        }
+        return component_pools_[family].get();
+    }
+
+    /// Picks the smallest pool among the families in the mask. Returns nullptr
+    /// when one of the families has no pool yet, as nothing can match then.
+    const component_storage* get_driver(const component_mask_t& mask) const
+    {
+        const component_storage* driver = nullptr;
+        for(std::size_t family = 0; family < MAX_COMPONENTS; ++family)
+        {
+            if(!mask.test(family))
+            {
+                continue;
+            }
+
+            if(family >= component_pools_.size() || !component_pools_[family])
+            {
+                return nullptr;
+            }
+
+            const auto& pool = component_pools_[family];
+            if(!driver || pool->members().size() < driver->members().size())
+            {
+                driver = pool.get();
+            }
+        }
+        return driver;
+    }
+
     component_mask_t component_mask(entity::id_t id)
     {
         assert_valid(id);
@@ -973,6 +1663,14 @@ private:
     std::vector<std::uint32_t> free_list_;
 
     std::unordered_map<std::uint64_t, std::string> entity_names_;
+
+    // Registered queries. Never removed so references to them stay valid.
+    std::vector<std::unique_ptr<cached_query>> queries_;
+    std::mutex queries_mutex_;
+
+    // Command buffers waiting for playback.
+    std::vector<entity_command_buffer> submitted_commands_;
+    std::mutex submitted_commands_mutex_;
 };
 
 template<typename C, typename... Args>
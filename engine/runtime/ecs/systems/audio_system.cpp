@@ -26,11 +26,16 @@ void audio_system::frame_update(delta_t dt)
 
 audio_system::audio_system()
 {
-    on_frame_update.connect(this, &audio_system::frame_update);
+    const auto access = system_access()
+                            .read<transform_component>()
+                            .write<audio_source_component, audio_listener_component>()
+                            .on_owner_thread();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("audio_system", this, &audio_system::frame_update, access);
 }
 
 audio_system::~audio_system()
 {
-    on_frame_update.disconnect(this, &audio_system::frame_update);
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
 }
 } // namespace runtime
@@ -9,21 +9,42 @@
 namespace runtime
 {
 
-void process_node(const std::unique_ptr<mesh::armature_node>& node,
-                  const skin_bind_data& bind_data,
-                  runtime::entity& parent,
-                  std::vector<runtime::entity>& entity_nodes,
-                  runtime::entity_component_system& ecs)
+runtime::entity resolve_node(const entity_command_buffer& /*unused*/, const runtime::entity& e)
 {
-    if(!parent.valid())
-        return;
+    return e;
+}
 
-    auto entity_node = ecs.create();
-    entity_node.set_name(node->name);
+runtime::entity resolve_node(const entity_command_buffer& cmd, entity_command_buffer::deferred_entity e)
+{
+    return cmd.resolve(e);
+}
 
-    auto transf_comp = entity_node.assign<transform_component>().lock();
-    transf_comp->set_parent(parent);
-    transf_comp->set_local_transform(node->local_transform);
+template<typename Parent>
+void process_node(const std::unique_ptr<mesh::armature_node>& node,
+                  const skin_bind_data& bind_data,
+                  Parent parent,
+                  std::vector<entity_command_buffer::deferred_entity>& entity_nodes,
+                  entity_command_buffer& cmd)
+{
+    auto entity_node = cmd.create();
+    cmd.assign<transform_component>(entity_node);
+    cmd.invoke(entity_node,
+               [parent, name = node->name, local_transform = node->local_transform](
+                   runtime::entity e, const entity_command_buffer& cmd)
+               {
+                   auto parent_entity = resolve_node(cmd, parent);
+                   if(!parent_entity.valid())
+                   {
+                       e.destroy();
+                       return;
+                   }
+
+                   e.set_name(name);
+
+                   auto transf_comp = e.get_component<transform_component>().lock();
+                   transf_comp->set_parent(parent_entity);
+                   transf_comp->set_local_transform(local_transform);
+               });
 
     auto bone = bind_data.find_bone_by_id(node->name);
     if(bone)
@@ -33,7 +54,7 @@ void process_node(const std::unique_ptr<mesh::armature_node>& node,
 
     for(auto& child : node->children)
     {
-        process_node(child, bind_data, entity_node, entity_nodes, ecs);
+        process_node(child, bind_data, entity_node, entity_nodes, cmd);
     }
 }
 
@@ -70,8 +91,12 @@ static std::vector<math::transform> get_transforms_for_bones(const std::vector<r
 void bone_system::frame_update(delta_t)
 {
     auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+
+    // The bone hierarchies are not created while iterating. They are recorded
+    // and created at the next sync point.
+    entity_command_buffer cmd;
     ecs.for_each<model_component>(
-        [&ecs](runtime::entity e, model_component& model_comp)
+        [&cmd](runtime::entity e, model_component& model_comp)
         {
             const auto& model = model_comp.get_model();
             auto mesh = model.get_lod(0);
@@ -88,10 +113,26 @@ void bone_system::frame_update(delta_t)
                 if(model_comp.get_bone_entities().size() <= 1)
                 {
                     const auto& armature = mesh->get_armature();
-                    std::vector<runtime::entity> be;
-                    process_node(armature, skin_data, e, be, ecs);
-                    model_comp.set_bone_entities(be);
-                    model_comp.set_static(false);
+                    std::vector<entity_command_buffer::deferred_entity> be;
+                    process_node(armature, skin_data, e, be, cmd);
+                    cmd.invoke(e,
+                               [be](runtime::entity e, const entity_command_buffer& cmd)
+                               {
+                                   auto model_comp = e.get_component<model_component>().lock();
+                                   if(!model_comp)
+                                   {
+                                       return;
+                                   }
+
+                                   std::vector<runtime::entity> bone_entities;
+                                   bone_entities.reserve(be.size());
+                                   for(const auto& node : be)
+                                   {
+                                       bone_entities.emplace_back(cmd.resolve(node));
+                                   }
+                                   model_comp->set_bone_entities(bone_entities);
+                                   model_comp->set_static(false);
+                               });
                 }
 
                 const auto& bone_entities = model_comp.get_bone_entities();
@@ -99,15 +140,19 @@ void bone_system::frame_update(delta_t)
                 model_comp.set_bone_transforms(std::move(transforms));
             }
         });
+
+    ecs.submit(std::move(cmd));
 }
 
 bone_system::bone_system()
 {
-    runtime::on_frame_update.connect(this, &bone_system::frame_update);
+    const auto access = system_access().read<transform_component>().write<model_component>();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("bone_system", this, &bone_system::frame_update, access);
 }
 
 bone_system::~bone_system()
 {
-    runtime::on_frame_update.disconnect(this, &bone_system::frame_update);
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
 }
 } // namespace runtime
@@ -0,0 +1,255 @@
+#include "bounds_system.h"
+#include "../../system/events.h"
+#include "../components/model_component.h"
+#include "../components/transform_component.h"
+
+#include <core/system/subsystem.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace runtime
+{
+namespace
+{
+const std::uint32_t INVALID_SLOT = std::numeric_limits<std::uint32_t>::max();
+/// Lets dynamic models move this far before they are reinserted in their tree.
+const float DYNAMIC_MARGIN = 0.1f;
+
+bool is_bounds_source(const chandle<component>& comp)
+{
+    auto ptr = comp.lock();
+    return std::dynamic_pointer_cast<transform_component>(ptr) != nullptr ||
+           std::dynamic_pointer_cast<model_component>(ptr) != nullptr;
+}
+} // namespace
+
+void bounds_system::update()
+{
+    auto& ecs = core::get_subsystem<entity_component_system>();
+    const auto since = last_tick_;
+    last_tick_ = ecs::get_change_tick();
+
+    ecs.for_each_changed<transform_component, model_component>(
+        since,
+        [this](entity e, transform_component& transform_comp, model_component& model_comp)
+        {
+            refresh(e, transform_comp, model_comp);
+        });
+
+    // Meshes finish loading without touching their model component.
+    for(std::size_t i = 0; pending_ > 0 && i < entities_.size(); ++i)
+    {
+        if(flags_[i] & has_mesh)
+        {
+            continue;
+        }
+
+        auto transform_comp = transforms_[i].lock();
+        auto model_comp = models_[i].lock();
+        if(transform_comp && model_comp && model_comp->get_model().get_lod(0))
+        {
+            refresh(entities_[i], *transform_comp, *model_comp);
+        }
+    }
+
+    // Incremental insertions keep the static tree balanced, a top down
+    // rebuild makes it tighter once a good part of it changed.
+    if(static_changes_ > 0 && static_changes_ * 8 >= static_tree_.size())
+    {
+        static_tree_.rebuild();
+        static_changes_ = 0;
+    }
+}
+
+void bounds_system::refresh(entity e, transform_component& transform_comp, model_component& model_comp)
+{
+    const auto index = e.id().index();
+    if(index >= slots_.size())
+    {
+        slots_.resize(index + 1, INVALID_SLOT);
+    }
+
+    auto slot = slots_[index];
+    if(slot == INVALID_SLOT)
+    {
+        slot = static_cast<std::uint32_t>(entities_.size());
+        slots_[index] = slot;
+        entities_.emplace_back(e);
+        transforms_.emplace_back(transform_comp.handle());
+        models_.emplace_back(model_comp.handle());
+        aabbs_.emplace_back();
+        spheres_.emplace_back();
+        flags_.emplace_back(std::uint8_t(0));
+        ticks_.emplace_back(0);
+        proxies_.emplace_back(math::bvh::null_node);
+        ++pending_;
+    }
+
+    std::uint8_t flags = 0;
+    flags |= model_comp.is_static() ? is_static : 0;
+    flags |= model_comp.casts_shadow() ? casts_shadow : 0;
+    flags |= model_comp.casts_reflection() ? casts_reflection : 0;
+    flags |= model_comp.is_occluder() ? is_occluder : 0;
+
+    const auto mesh = model_comp.get_model().get_lod(0);
+    if(mesh)
+    {
+        flags |= has_mesh;
+
+        const auto& bounds = mesh->get_bounds();
+        const math::affine3x4 world(transform_comp.get_transform());
+        const auto center = world.transform_coord(bounds.get_center());
+        const auto extents = bounds.get_extents();
+
+        // The half extent axes of the box in world space.
+        math::vec3 axes[3];
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            axes[axis] = math::vec3(world[0][axis], world[1][axis], world[2][axis]) * extents[axis];
+        }
+
+        const auto half = math::abs(axes[0]) + math::abs(axes[1]) + math::abs(axes[2]);
+        aabbs_[slot] = math::bbox(center - half, center + half);
+
+        // The farthest corner, the axes are not orthogonal under shear.
+        const float radius = std::max(std::max(math::length(axes[0] + axes[1] + axes[2]),
+                                               math::length(axes[0] + axes[1] - axes[2])),
+                                      std::max(math::length(axes[0] - axes[1] + axes[2]),
+                                               math::length(axes[0] - axes[1] - axes[2])));
+        spheres_[slot] = math::bsphere(center, radius);
+    }
+
+    if(!(flags_[slot] & has_mesh) && (flags & has_mesh))
+    {
+        --pending_;
+    }
+    else if((flags_[slot] & has_mesh) && !(flags & has_mesh))
+    {
+        ++pending_;
+    }
+
+    update_proxy(slot, flags_[slot], flags);
+
+    flags_[slot] = flags;
+    ticks_[slot] = std::max(transform_comp.get_last_touched(), model_comp.get_last_touched());
+}
+
+void bounds_system::update_proxy(std::uint32_t slot, std::uint8_t old_flags, std::uint8_t flags)
+{
+    auto tree_of = [this](std::uint8_t f) -> math::bvh*
+    {
+        if(!(f & has_mesh))
+        {
+            return nullptr;
+        }
+        return (f & is_static) ? &static_tree_ : &dynamic_tree_;
+    };
+
+    auto old_tree = tree_of(old_flags);
+    auto new_tree = tree_of(flags);
+    auto& proxy = proxies_[slot];
+    if(old_tree == new_tree)
+    {
+        if(new_tree)
+        {
+            new_tree->move(proxy, aabbs_[slot]);
+        }
+    }
+    else
+    {
+        if(old_tree)
+        {
+            old_tree->remove(proxy);
+            proxy = math::bvh::null_node;
+        }
+        if(new_tree)
+        {
+            proxy = new_tree->insert(aabbs_[slot], entities_[slot].id().index());
+        }
+    }
+
+    if(old_tree == &static_tree_ || new_tree == &static_tree_)
+    {
+        ++static_changes_;
+    }
+}
+
+void bounds_system::remove(entity e)
+{
+    const auto index = e.id().index();
+    if(index >= slots_.size() || slots_[index] == INVALID_SLOT)
+    {
+        return;
+    }
+
+    const auto slot = slots_[index];
+    slots_[index] = INVALID_SLOT;
+    if(!(flags_[slot] & has_mesh))
+    {
+        --pending_;
+    }
+    update_proxy(slot, flags_[slot], 0);
+
+    // Move the last entry into the hole.
+    const auto last = entities_.size() - 1;
+    if(slot != last)
+    {
+        slots_[entities_[last].id().index()] = slot;
+        entities_[slot] = entities_[last];
+        transforms_[slot] = std::move(transforms_[last]);
+        models_[slot] = std::move(models_[last]);
+        aabbs_[slot] = aabbs_[last];
+        spheres_[slot] = spheres_[last];
+        flags_[slot] = flags_[last];
+        ticks_[slot] = ticks_[last];
+        proxies_[slot] = proxies_[last];
+    }
+
+    entities_.pop_back();
+    transforms_.pop_back();
+    models_.pop_back();
+    aabbs_.pop_back();
+    spheres_.pop_back();
+    flags_.pop_back();
+    ticks_.pop_back();
+    proxies_.pop_back();
+}
+
+void bounds_system::frame_update(delta_t)
+{
+    update();
+}
+
+void bounds_system::frame_render(delta_t)
+{
+    update();
+}
+
+void bounds_system::on_component_removed(entity e, chandle<component> comp)
+{
+    if(is_bounds_source(comp))
+    {
+        remove(e);
+    }
+}
+
+bounds_system::bounds_system()
+    : dynamic_tree_(DYNAMIC_MARGIN)
+{
+    // Registered after the transform system, so the world transforms are
+    // already resolved.
+    const auto access = system_access().read<transform_component, model_component>();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("bounds_system", this, &bounds_system::frame_update, access);
+    on_frame_render.connect(this, &bounds_system::frame_render);
+    runtime::on_component_removed.connect(this, &bounds_system::on_component_removed);
+}
+
+bounds_system::~bounds_system()
+{
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
+    on_frame_render.disconnect(this, &bounds_system::frame_render);
+    runtime::on_component_removed.disconnect(this, &bounds_system::on_component_removed);
+}
+} // namespace runtime
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../ecs.h"
+#include "system_scheduler.h"
+
+#include <core/common/basetypes.hpp>
+#include <core/math/math_includes.h>
+
+#include <cstdint>
+#include <vector>
+
+class transform_component;
+class model_component;
+
+namespace runtime
+{
+//-----------------------------------------------------------------------------
+//  Name : bounds_system (Class)
+/// <summary>
+/// Caches the world space bounds of every entity with a transform and a
+/// model in contiguous arrays. An entry is only refreshed when its transform
+/// or model component changes, or while its LOD 0 mesh is still loading, so
+/// culling can run over the arrays without touching the components.
+/// All arrays share the same indexing and their order is unspecified.
+/// The entries with a mesh are also indexed by two bounding volume
+/// hierarchies, one for static and one for dynamic models, so spatial
+/// queries only visit the relevant part of the scene.
+/// </summary>
+//-----------------------------------------------------------------------------
+class bounds_system
+{
+public:
+    enum flags : std::uint8_t
+    {
+        /// the LOD 0 mesh is loaded and the bounds are valid
+        has_mesh = 1 << 0,
+        is_static = 1 << 1,
+        casts_shadow = 1 << 2,
+        casts_reflection = 1 << 3,
+        is_occluder = 1 << 4,
+    };
+
+    bounds_system();
+    ~bounds_system();
+
+    //-----------------------------------------------------------------------------
+    //  Name : update ()
+    /// <summary>
+    /// Refreshes the entries changed since the last update. Cheap when
+    /// nothing changed, so it can be called before every use.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void update();
+
+    inline std::size_t size() const
+    {
+        return entities_.size();
+    }
+
+    inline const std::vector<entity>& get_entities() const
+    {
+        return entities_;
+    }
+
+    inline const std::vector<chandle<transform_component>>& get_transforms() const
+    {
+        return transforms_;
+    }
+
+    inline const std::vector<chandle<model_component>>& get_models() const
+    {
+        return models_;
+    }
+
+    /// world space axis aligned boxes enclosing the LOD 0 mesh bounds
+    inline const std::vector<math::bbox>& get_aabbs() const
+    {
+        return aabbs_;
+    }
+
+    /// world space spheres enclosing the LOD 0 mesh bounds
+    inline const std::vector<math::bsphere>& get_spheres() const
+    {
+        return spheres_;
+    }
+
+    inline const std::vector<std::uint8_t>& get_flags() const
+    {
+        return flags_;
+    }
+
+    /// latest change tick of the transform and model components
+    inline const std::vector<ecs::change_tick_t>& get_change_ticks() const
+    {
+        return ticks_;
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : query ()
+    /// <summary>
+    /// Calls f(index) for every entry whose world bounds intersect the
+    /// volume, a math::bbox, math::bsphere or math::frustum. 'index' indexes
+    /// the arrays above. Entries without a mesh are never reported.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    template<typename Volume, typename F>
+    void query(const Volume& volume, F&& f) const
+    {
+        auto report = [this, &f](std::uint32_t entity_index) { f(std::size_t(slots_[entity_index])); };
+        static_tree_.query(volume, report);
+        dynamic_tree_.query(volume, report);
+    }
+
+    //-----------------------------------------------------------------------------
+    //  Name : query_ray ()
+    /// <summary>
+    /// Calls f(index, t) for every entry hit by the segment going from
+    /// 'origin' to 'origin + velocity', see math::bvh::query_ray.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    template<typename F>
+    void query_ray(const math::vec3& origin, const math::vec3& velocity, F&& f) const
+    {
+        auto report = [this, &f](std::uint32_t entity_index, float t) { f(std::size_t(slots_[entity_index]), t); };
+        static_tree_.query_ray(origin, velocity, report);
+        dynamic_tree_.query_ray(origin, velocity, report);
+    }
+
+private:
+    void frame_update(delta_t dt);
+    void frame_render(delta_t dt);
+
+    void refresh(entity e, transform_component& transform_comp, model_component& model_comp);
+    void update_proxy(std::uint32_t slot, std::uint8_t old_flags, std::uint8_t flags);
+    void remove(entity e);
+
+    void on_component_removed(entity e, chandle<component> comp);
+
+    /// dense index of each entry by entity index, or INVALID_SLOT
+    std::vector<std::uint32_t> slots_;
+    std::vector<entity> entities_;
+    std::vector<chandle<transform_component>> transforms_;
+    std::vector<chandle<model_component>> models_;
+    std::vector<math::bbox> aabbs_;
+    std::vector<math::bsphere> spheres_;
+    std::vector<std::uint8_t> flags_;
+    std::vector<ecs::change_tick_t> ticks_;
+    /// leaf of each entry in its tree, or math::bvh::null_node without a mesh
+    std::vector<std::int32_t> proxies_;
+    math::bvh static_tree_;
+    math::bvh dynamic_tree_;
+    /// static leaves inserted, moved or removed since the last rebuild
+    std::size_t static_changes_ = 0;
+    /// entries waiting for their LOD 0 mesh
+    std::size_t pending_ = 0;
+    /// change tick of the last update
+    ecs::change_tick_t last_tick_ = 0;
+    /// registration of frame_update in the system_scheduler
+    system_scheduler::system_id update_id_ = 0;
+};
+} // namespace runtime
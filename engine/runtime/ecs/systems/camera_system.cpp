@@ -20,11 +20,13 @@ void camera_system::frame_update(delta_t)
 
 camera_system::camera_system()
 {
-    on_frame_update.connect(this, &camera_system::frame_update);
+    const auto access = system_access().read<transform_component>().write<camera_component>().on_owner_thread();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("camera_system", this, &camera_system::frame_update, access);
 }
 
 camera_system::~camera_system()
 {
-    on_frame_update.disconnect(this, &camera_system::frame_update);
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
 }
 } // namespace runtime
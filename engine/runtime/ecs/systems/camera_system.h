@@ -1,5 +1,7 @@
 #pragma once
 
+#include "system_scheduler.h"
+
 #include <core/common/basetypes.hpp>
 
 namespace runtime
@@ -18,5 +20,9 @@ public:
     /// </summary>
     //-----------------------------------------------------------------------------
     void frame_update(delta_t dt);
+
+private:
+    /// registration of frame_update in the system_scheduler
+    system_scheduler::system_id update_id_ = 0;
 };
 } // namespace runtime
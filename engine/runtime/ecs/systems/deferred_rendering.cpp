@@ -11,16 +11,26 @@
 #include "../components/model_component.h"
 #include "../components/reflection_probe_component.h"
 #include "../components/transform_component.h"
+#include "bounds_system.h"
 
 #include <core/graphics/index_buffer.h>
 #include <core/graphics/render_pass.h>
 #include <core/graphics/render_view.h>
 #include <core/graphics/texture.h>
 #include <core/graphics/vertex_buffer.h>
+#include <core/profiler/profiler.h>
 #include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <algorithm>
 
 namespace runtime
 {
+namespace
+{
+/// Occluders rasterized per view, the largest on screen first.
+const std::size_t MAX_OCCLUDERS = 32;
+} // namespace
 
 bool update_lod_data(lod_data& data,
                      const std::vector<urange32_t>& lod_limits,
@@ -151,97 +161,260 @@ bool should_rebuild_shadows(visibility_set_models_t& visibility_set, const light
     return false;
 }
 
-visibility_set_models_t deferred_rendering::gather_visible_models(entity_component_system& ecs,
+visibility_set_models_t deferred_rendering::gather_visible_models(entity_component_system& /*ecs*/,
                                                                   camera* camera,
-                                                                  bool dirty_only /* = false*/,
+                                                                  ecs::change_tick_t dirty_since /* = 0*/,
                                                                   bool static_only /*= true*/,
                                                                   bool require_reflection_caster /*= false*/)
 {
-    visibility_set_models_t result;
-    chandle<transform_component> transform_comp_handle;
-    chandle<model_component> model_comp_handle;
-    for(auto entity : ecs.entities_with_components(transform_comp_handle, model_comp_handle))
+    auto& bounds = core::get_subsystem<bounds_system>();
+    bounds.update();
+
+    auto visible = collect_visible(bounds, camera, dirty_since, static_only, require_reflection_caster);
+    return to_visibility_set(bounds, visible);
+}
+
+void deferred_rendering::gather_visible_models(std::vector<view_visibility>& views)
+{
+    PROFILE_SCOPE("deferred_rendering::gather_visible_models");
+
+    if(views.empty())
     {
-        auto model_comp_ptr = model_comp_handle.lock();
-        auto transform_comp_ptr = transform_comp_handle.lock();
+        return;
+    }
 
-        if(static_only && !model_comp_ptr->is_static())
-        {
-            continue;
-        }
+    auto& bounds = core::get_subsystem<bounds_system>();
+    bounds.update();
 
-        if(require_reflection_caster && !model_comp_ptr->casts_reflection())
+    // Frustums and matrices are computed lazily, do it before going wide.
+    for(const auto& view : views)
+    {
+        view.view_camera->get_frustum();
+        view.view_camera->get_view();
+        view.view_camera->get_projection();
+    }
+
+    if(occlusion_buffers_.size() < views.size())
+    {
+        occlusion_buffers_.resize(views.size());
+    }
+
+    auto gather = [this, &bounds](view_visibility& view, math::occlusion_buffer& occlusion)
+    {
+        PROFILE_SCOPE("gather_view");
+        auto visible =
+            collect_visible(bounds, view.view_camera, 0, view.static_only, view.require_reflection_caster);
+        if(occlusion_culling_)
         {
-            continue;
+            view.occlusion = cull_occluded(bounds, *view.view_camera, visible, occlusion);
         }
+        view.visibility_set = to_visibility_set(bounds, visible);
+    };
+
+    // Waits for every view before rethrowing, the views and buffers live here.
+    auto& tasks = core::get_subsystem<core::task_system>();
+    tasks.parallel_for(0, views.size(), 1,
+                       [this, &gather, &views](std::size_t first, std::size_t last)
+                       {
+                           for(auto i = first; i < last; ++i)
+                           {
+                               gather(views[i], occlusion_buffers_[i]);
+                           }
+                       },
+                       core::task_priority::frame_critical);
+}
 
-        auto mesh = model_comp_ptr->get_model().get_lod(0);
+std::vector<std::size_t> deferred_rendering::collect_visible(const bounds_system& bounds,
+                                                             const camera* camera,
+                                                             ecs::change_tick_t dirty_since,
+                                                             bool static_only,
+                                                             bool require_reflection_caster)
+{
+    const auto& flags = bounds.get_flags();
+    const auto& ticks = bounds.get_change_ticks();
+
+    std::uint8_t required = bounds_system::has_mesh;
+    required |= static_only ? bounds_system::is_static : 0;
+    required |= require_reflection_caster ? bounds_system::casts_reflection : 0;
 
+    std::vector<std::size_t> result;
+    auto gather = [&](std::size_t i)
+    {
         // If mesh isnt loaded yet skip it.
-        if(!mesh)
-            continue;
+        if((flags[i] & required) != required)
+            return;
 
-        if(camera)
+        // Only dirty mesh components.
+        if(dirty_since > 0 && ticks[i] <= dirty_since)
+            return;
+
+        result.emplace_back(i);
+    };
+
+    if(camera)
+    {
+        // Only visits the parts of the scene inside the frustum.
+        bounds.query(camera->get_frustum(), gather);
+    }
+    else
+    {
+        for(std::size_t i = 0; i < bounds.size(); ++i)
         {
-            const auto& frustum = camera->get_frustum();
+            gather(i);
+        }
+    }
+    return result;
+}
 
-            const auto& world_transform = transform_comp_ptr->get_transform();
+occlusion_stats deferred_rendering::cull_occluded(const bounds_system& bounds,
+                                                  const camera& camera,
+                                                  std::vector<std::size_t>& visible,
+                                                  math::occlusion_buffer& occlusion)
+{
+    occlusion_stats stats;
+    stats.draws = visible.size();
 
-            const auto& bounds = mesh->get_bounds();
+    const auto& flags = bounds.get_flags();
+    const auto& spheres = bounds.get_spheres();
+    const auto eye = camera.get_position();
 
-            // Test the bounding box of the mesh
-            if(math::frustum::test_obb(frustum, bounds, world_transform))
-            {
-                // Only dirty mesh components.
-                if(dirty_only)
-                {
-                    if(transform_comp_ptr->is_touched() || model_comp_ptr->is_touched())
-                    {
-                        result.emplace_back(entity, transform_comp_handle, model_comp_handle);
-                    }
-                } // End if dirty_only
-                else
-                {
-                    result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-                }
+    // Rough screen size of each occluder, the largest ones hide the most.
+    std::vector<std::pair<float, std::size_t>> occluders;
+    for(const auto i : visible)
+    {
+        if(flags[i] & bounds_system::is_occluder)
+        {
+            const auto& sphere = spheres[i];
+            const float distance =
+                std::max(math::length(sphere.position - eye) - sphere.radius, camera.get_near_clip());
+            occluders.emplace_back(sphere.radius / distance, i);
+        }
+    }
+
+    if(occluders.empty())
+    {
+        return stats;
+    }
 
-            } // Enf if visble
+    const auto count = std::min(occluders.size(), MAX_OCCLUDERS);
+    std::partial_sort(std::begin(occluders),
+                      std::begin(occluders) + std::ptrdiff_t(count),
+                      std::end(occluders),
+                      [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+    occlusion.clear(camera.get_view_projection());
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        const auto index = occluders[i].second;
+        auto transform_comp = bounds.get_transforms()[index].lock();
+        auto model_comp = bounds.get_models()[index].lock();
+        if(!transform_comp || !model_comp)
+        {
+            continue;
         }
-        else
+
+        const auto mesh = model_comp->get_model().get_lod(0);
+        if(!mesh || !mesh->get_system_vb() || !mesh->get_system_ib())
         {
-            // Only dirty mesh components.
-            if(dirty_only)
-            {
-                if(transform_comp_ptr->is_touched() || model_comp_ptr->is_touched())
-                {
-                    result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-                }
-            } // End if dirty_only
-            else
-            {
-                result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-            }
+            continue;
         }
+
+        const auto& format = mesh->get_vertex_format();
+        occlusion.draw_triangles(transform_comp->get_transform(),
+                                 mesh->get_system_vb() + format.getOffset(gfx::attribute::Position),
+                                 format.getStride(),
+                                 mesh->get_vertex_count(),
+                                 mesh->get_system_ib(),
+                                 std::size_t(mesh->get_face_count()) * 3);
+    }
+
+    // Occluders are tested too, the depth bias keeps them from hiding themselves.
+    const auto& aabbs = bounds.get_aabbs();
+    auto hidden = std::remove_if(std::begin(visible),
+                                 std::end(visible),
+                                 [&occlusion, &aabbs](std::size_t i) { return occlusion.is_occluded(aabbs[i]); });
+    stats.occluded = std::size_t(std::distance(hidden, std::end(visible)));
+    visible.erase(hidden, std::end(visible));
+    return stats;
+}
+
+visibility_set_models_t deferred_rendering::to_visibility_set(const bounds_system& bounds,
+                                                              const std::vector<std::size_t>& visible)
+{
+    visibility_set_models_t result;
+    result.reserve(visible.size());
+    for(const auto i : visible)
+    {
+        result.emplace_back(bounds.get_entities()[i], bounds.get_transforms()[i], bounds.get_models()[i]);
     }
     return result;
 }
 
+void deferred_rendering::set_occlusion_culling(bool enabled)
+{
+    occlusion_culling_ = enabled;
+}
+
+bool deferred_rendering::is_occlusion_culling() const
+{
+    return occlusion_culling_;
+}
+
+const std::unordered_map<entity, occlusion_stats>& deferred_rendering::get_occlusion_stats() const
+{
+    return occlusion_stats_;
+}
+
 void deferred_rendering::frame_render(delta_t dt)
 {
+    PROFILE_SCOPE("deferred_rendering::frame_render");
+
     auto& ecs = core::get_subsystem<entity_component_system>();
 
-    build_reflections_pass(ecs, dt);
+    // Every view of the frame finds what it sees in parallel, before
+    // anything gets submitted.
+    std::vector<view_visibility> views;
+    auto probes = prepare_reflections(ecs, views);
+    auto cameras = prepare_cameras(ecs, views);
+    gather_visible_models(views);
+
+    occlusion_stats_.clear();
+    for(const auto& faces : probes)
+    {
+        if(!faces.has_views)
+            continue;
+
+        auto& stats = occlusion_stats_[faces.probe_entity];
+        for(std::size_t i = 0; i < faces.cameras.size(); ++i)
+        {
+            stats.draws += views[faces.first_view + i].occlusion.draws;
+            stats.occluded += views[faces.first_view + i].occlusion.occluded;
+        }
+    }
+    for(const auto& camera_view : cameras)
+    {
+        occlusion_stats_[camera_view.camera_entity] = views[camera_view.view].occlusion;
+    }
+
+    build_reflections_pass(ecs, probes, views, dt);
     build_shadows_pass(ecs, dt);
-    camera_pass(ecs, dt);
+    camera_pass(ecs, cameras, views, dt);
 }
 
-void deferred_rendering::build_reflections_pass(entity_component_system& ecs, delta_t dt)
+std::vector<deferred_rendering::probe_faces> deferred_rendering::prepare_reflections(entity_component_system& ecs,
+                                                                                   std::vector<view_visibility>& views)
 {
-    auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
+    // Everything changed since the last time this pass ran, no matter how
+    // many frames ago that was.
+    const auto dirty_since = reflections_tick_;
+    reflections_tick_ = ecs::get_change_tick();
+
+    std::vector<probe_faces> probes;
+    auto dirty_models = gather_visible_models(ecs, nullptr, dirty_since, true, true);
     ecs.for_each<transform_component, reflection_probe_component>(
-        [this, &ecs, dt, &dirty_models](entity ce,
-                                        transform_component& transform_comp,
-                                        reflection_probe_component& reflection_probe_comp)
+        [&probes, &dirty_models, dirty_since](entity ce,
+                                              transform_component& transform_comp,
+                                              reflection_probe_component& reflection_probe_comp)
         {
             const auto& world_tranform = transform_comp.get_transform();
             const auto& probe = reflection_probe_comp.get_probe();
@@ -249,7 +422,7 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, de
             auto cubemap_fbo = reflection_probe_comp.get_cubemap_fbo();
             bool should_rebuild = true;
 
-            if(!transform_comp.is_touched() && !reflection_probe_comp.is_touched())
+            if(!transform_comp.changed_since(dirty_since) && !reflection_probe_comp.changed_since(dirty_since))
             {
                 // If reflections shouldn't be rebuilt - continue.
                 should_rebuild = should_rebuild_reflections(dirty_models, probe);
@@ -258,54 +431,124 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, de
             if(!should_rebuild)
                 return;
 
+            probes.emplace_back();
+            auto& faces = probes.back();
+            faces.probe_entity = ce;
+            faces.probe_comp = &reflection_probe_comp;
+            faces.has_views = probe.method != reflect_method::environment;
+
             // iterate trough each cube face
             for(std::uint32_t i = 0; i < 6; ++i)
             {
-                auto camera = camera::get_face_camera(i, world_tranform);
-                camera.set_far_clip(reflection_probe_comp.get_probe().box_data.extents.r);
-                auto& render_view = reflection_probe_comp.get_render_view(i);
+                auto& camera = faces.cameras[i];
+                camera = camera::get_face_camera(i, world_tranform);
+                camera.set_far_clip(probe.box_data.extents.r);
                 camera.set_viewport_size(usize32_t(cubemap_fbo->get_size()));
-                auto& camera_lods = lod_data_[ce];
-                visibility_set_models_t visibility_set;
-
-                if(probe.method != reflect_method::environment)
-                    visibility_set = gather_visible_models(ecs, &camera, !should_rebuild, true, true);
-
-                std::shared_ptr<gfx::frame_buffer> output = nullptr;
-                output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
-                output = lighting_pass(output, camera, render_view, ecs, dt);
-                output = atmospherics_pass(output, camera, render_view, ecs, dt);
-                output = tonemapping_pass(output, camera, render_view);
-
-                gfx::render_pass pass("cubemap_fill");
-                pass.touch();
-                gfx::blit(pass.id,
-                          cubemap_fbo->get_texture()->native_handle(),
-                          0,
-                          0,
-                          0,
-                          std::uint16_t(i),
-                          output->get_texture()->native_handle());
             }
+        });
 
-            gfx::render_pass pass("cubemap_generate_mips");
-            pass.bind(cubemap_fbo.get());
-            pass.touch();
+    // The probes are all known, the cameras do not move anymore.
+    for(auto& faces : probes)
+    {
+        if(!faces.has_views)
+            continue;
+
+        faces.first_view = views.size();
+        for(auto& camera : faces.cameras)
+        {
+            view_visibility view;
+            view.view_camera = &camera;
+            view.static_only = true;
+            view.require_reflection_caster = true;
+            views.emplace_back(std::move(view));
+        }
+    }
+    return probes;
+}
+
+std::vector<deferred_rendering::camera_view> deferred_rendering::prepare_cameras(entity_component_system& ecs,
+                                                                               std::vector<view_visibility>& views)
+{
+    std::vector<camera_view> cameras;
+    ecs.for_each<camera_component>(
+        [&cameras, &views](entity ce, camera_component& camera_comp)
+        {
+            camera_view camera;
+            camera.camera_entity = ce;
+            camera.camera_comp = &camera_comp;
+            camera.view = views.size();
+            cameras.emplace_back(camera);
+
+            view_visibility view;
+            view.view_camera = &camera_comp.get_camera();
+            views.emplace_back(std::move(view));
         });
+    return cameras;
+}
+
+void deferred_rendering::build_reflections_pass(entity_component_system& ecs,
+                                                const std::vector<probe_faces>& probes,
+                                                std::vector<view_visibility>& views,
+                                                delta_t dt)
+{
+    PROFILE_SCOPE("deferred_rendering::build_reflections_pass");
+
+    for(const auto& faces : probes)
+    {
+        auto& reflection_probe_comp = *faces.probe_comp;
+        auto cubemap_fbo = reflection_probe_comp.get_cubemap_fbo();
+        auto& camera_lods = lod_data_[faces.probe_entity];
+
+        // iterate trough each cube face
+        for(std::uint32_t i = 0; i < 6; ++i)
+        {
+            auto camera = faces.cameras[i];
+            auto& render_view = reflection_probe_comp.get_render_view(i);
+            visibility_set_models_t environment_only;
+            auto& visibility_set = faces.has_views ? views[faces.first_view + i].visibility_set : environment_only;
+
+            std::shared_ptr<gfx::frame_buffer> output = nullptr;
+            output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
+            output = lighting_pass(output, camera, render_view, ecs, dt);
+            output = atmospherics_pass(output, camera, render_view, ecs, dt);
+            output = tonemapping_pass(output, camera, render_view);
+
+            gfx::render_pass pass("cubemap_fill");
+            pass.touch();
+            gfx::blit(pass.id,
+                      cubemap_fbo->get_texture()->native_handle(),
+                      0,
+                      0,
+                      0,
+                      std::uint16_t(i),
+                      output->get_texture()->native_handle());
+        }
+
+        gfx::render_pass pass("cubemap_generate_mips");
+        pass.bind(cubemap_fbo.get());
+        pass.touch();
+    }
 }
 
 void deferred_rendering::build_shadows_pass(entity_component_system& ecs, delta_t dt)
 {
-    auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
+    PROFILE_SCOPE("deferred_rendering::build_shadows_pass");
+
+    const auto dirty_since = shadows_tick_;
+    shadows_tick_ = ecs::get_change_tick();
+
+    auto dirty_models = gather_visible_models(ecs, nullptr, dirty_since, true, true);
     ecs.for_each<transform_component, light_component>(
-        [this, &ecs, dt, &dirty_models](entity ce, transform_component& transform_comp, light_component& light_comp)
+        [this, &ecs, dt, &dirty_models, dirty_since](entity ce,
+                                                     transform_component& transform_comp,
+                                                     light_component& light_comp)
         {
             // const auto& world_tranform = transform_comp.get_transform();
             const auto& light = light_comp.get_light();
 
             bool should_rebuild = true;
 
-            if(!transform_comp.is_touched() && !light_comp.is_touched())
+            if(!transform_comp.changed_since(dirty_since) && !light_comp.changed_since(dirty_since))
             {
                 // If shadows shouldn't be rebuilt - continue.
                 should_rebuild = should_rebuild_shadows(dirty_models, light);
@@ -316,30 +559,35 @@ void deferred_rendering::build_shadows_pass(entity_component_system& ecs, delta_
         });
 }
 
-void deferred_rendering::camera_pass(entity_component_system& ecs, delta_t dt)
+void deferred_rendering::camera_pass(entity_component_system& ecs,
+                                     const std::vector<camera_view>& cameras,
+                                     std::vector<view_visibility>& views,
+                                     delta_t dt)
 {
-    ecs.for_each<camera_component>(
-        [this, &ecs, dt](entity ce, camera_component& camera_comp)
-        {
-            auto& camera_lods = lod_data_[ce];
-            auto& camera = camera_comp.get_camera();
-            auto& render_view = camera_comp.get_render_view();
+    PROFILE_SCOPE("deferred_rendering::camera_pass");
 
-            auto output = deferred_render_full(camera, render_view, ecs, camera_lods, dt);
-        });
+    for(const auto& camera_view : cameras)
+    {
+        auto& camera_comp = *camera_view.camera_comp;
+        auto& camera_lods = lod_data_[camera_view.camera_entity];
+        auto& camera = camera_comp.get_camera();
+        auto& render_view = camera_comp.get_render_view();
+        auto& visibility_set = views[camera_view.view].visibility_set;
+
+        auto output = deferred_render_full(camera, render_view, ecs, visibility_set, camera_lods, dt);
+    }
 }
 
 std::shared_ptr<gfx::frame_buffer> deferred_rendering::deferred_render_full(
     camera& camera,
     gfx::render_view& render_view,
     entity_component_system& ecs,
+    visibility_set_models_t& visibility_set,
     std::unordered_map<entity, lod_data>& camera_lods,
     delta_t dt)
 {
     std::shared_ptr<gfx::frame_buffer> output = nullptr;
 
-    auto visibility_set = gather_visible_models(ecs, &camera, false, false, false);
-
     output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
 
     output = reflection_probe_pass(output, camera, render_view, ecs, dt);
@@ -360,6 +608,8 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::g_buffer_pass(std::shared
                                                                      std::unordered_map<entity, lod_data>& camera_lods,
                                                                      delta_t dt)
 {
+    PROFILE_SCOPE("deferred_rendering::g_buffer_pass");
+
     const auto& view = camera.get_view();
     const auto& proj = camera.get_projection();
     const auto& viewport_size = camera.get_viewport_size();
@@ -460,6 +710,8 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
                                                                      entity_component_system& ecs,
                                                                      delta_t dt)
 {
+    PROFILE_SCOPE("deferred_rendering::lighting_pass");
+
     const auto& view = camera.get_view();
     const auto& proj = camera.get_projection();
 
@@ -569,6 +821,8 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::reflection_probe_pass(std
                                                                              entity_component_system& ecs,
                                                                              delta_t dt)
 {
+    PROFILE_SCOPE("deferred_rendering::reflection_probe_pass");
+
     const auto& view = camera.get_view();
     const auto& proj = camera.get_projection();
 
@@ -671,6 +925,8 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::atmospherics_pass(std::sh
                                                                          entity_component_system& ecs,
                                                                          delta_t dt)
 {
+    PROFILE_SCOPE("deferred_rendering::atmospherics_pass");
+
     auto far_clip_cache = camera.get_far_clip();
     camera.set_far_clip(10000.0f);
     const auto& view = camera.get_view();
@@ -741,6 +997,8 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::tonemapping_pass(std::sha
                                                                         camera& camera,
                                                                         gfx::render_view& render_view)
 {
+    PROFILE_SCOPE("deferred_rendering::tonemapping_pass");
+
     if(!input)
         return nullptr;
 
@@ -777,9 +1035,25 @@ void deferred_rendering::receive(entity e)
         pair.second.erase(e);
     }
 }
+void deferred_rendering::receive_many(hpp::span<const entity> entities)
+{
+    for(const auto& e : entities)
+    {
+        lod_data_.erase(e);
+    }
+    for(auto& pair : lod_data_)
+    {
+        for(const auto& e : entities)
+        {
+            pair.second.erase(e);
+        }
+    }
+}
+
 deferred_rendering::deferred_rendering()
 {
     on_entity_destroyed.connect(this, &deferred_rendering::receive);
+    on_entities_destroyed.connect(this, &deferred_rendering::receive_many);
     on_frame_render.connect(this, &deferred_rendering::frame_render);
 
     auto& ts = core::get_subsystem<core::task_system>();
@@ -863,6 +1137,7 @@ deferred_rendering::deferred_rendering()
 deferred_rendering::~deferred_rendering()
 {
     on_entity_destroyed.disconnect(this, &deferred_rendering::receive);
+    on_entities_destroyed.disconnect(this, &deferred_rendering::receive_many);
     on_frame_render.disconnect(this, &deferred_rendering::frame_render);
 }
 } // namespace runtime
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../../rendering/camera.h"
 #include "../../rendering/gpu_program.h"
 #include "../components/model_component.h"
 #include "../components/transform_component.h"
@@ -7,12 +8,14 @@
 
 #include <core/common/basetypes.hpp>
 
+#include <array>
 #include <chrono>
 #include <memory>
 #include <tuple>
 #include <vector>
 
-class camera;
+class camera_component;
+class reflection_probe_component;
 
 namespace gfx
 {
@@ -32,24 +35,111 @@ struct lod_data
 
 using visibility_set_models_t = std::vector<std::tuple<entity, chandle<transform_component>, chandle<model_component>>>;
 
+//-----------------------------------------------------------------------------
+//  Name : occlusion_stats (Struct)
+/// <summary>
+/// How many draws of a view the CPU occlusion culling removed.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct occlusion_stats
+{
+    /// models left after frustum culling
+    std::size_t draws = 0;
+    /// models among those hidden by occluders
+    std::size_t occluded = 0;
+
+    inline float get_culled_percentage() const
+    {
+        return draws == 0 ? 0.0f : 100.0f * float(occluded) / float(draws);
+    }
+};
+
+//-----------------------------------------------------------------------------
+//  Name : view_visibility (Struct)
+/// <summary>
+/// A view rendered this frame together with the models it sees.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct view_visibility
+{
+    camera* view_camera = nullptr;
+    bool static_only = false;
+    bool require_reflection_caster = false;
+    visibility_set_models_t visibility_set;
+    occlusion_stats occlusion;
+};
+
+class bounds_system;
+
 class deferred_rendering
 {
 public:
+    /// A reflection probe rebuilt this frame and the cameras of its faces.
+    struct probe_faces
+    {
+        entity probe_entity;
+        reflection_probe_component* probe_comp = nullptr;
+        std::array<camera, 6> cameras;
+        /// index of the first face in the frame views, the faces of probes
+        /// rendering only the environment have no view
+        std::size_t first_view = 0;
+        bool has_views = false;
+    };
+
+    /// A camera rendered this frame.
+    struct camera_view
+    {
+        entity camera_entity;
+        camera_component* camera_comp = nullptr;
+        /// index in the frame views
+        std::size_t view = 0;
+    };
+
     deferred_rendering();
     ~deferred_rendering();
     //-----------------------------------------------------------------------------
     //  Name : gather_visible_models ()
     /// <summary>
-    ///
-    ///
-    ///
+    /// Collects the models visible by the camera. If 'dirty_since' is not 0
+    /// only models whose transform or model component changed after that
+    /// change tick are collected.
     /// </summary>
     //-----------------------------------------------------------------------------
     visibility_set_models_t gather_visible_models(entity_component_system& ecs,
                                                   camera* camera,
-                                                  bool dirty_only = false,
+                                                  ecs::change_tick_t dirty_since = 0,
                                                   bool static_only = true,
                                                   bool require_reflection_caster = false);
+
+    //-----------------------------------------------------------------------------
+    //  Name : gather_visible_models ()
+    /// <summary>
+    /// Fills the visibility set of every view, one task per view on the task
+    /// system. Only reads the scene.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void gather_visible_models(std::vector<view_visibility>& views);
+
+    //-----------------------------------------------------------------------------
+    //  Name : set_occlusion_culling ()
+    /// <summary>
+    /// Enables culling the models hidden behind occluders, see
+    /// model_component::set_occluder. On by default, it costs nothing while
+    /// a view sees no occluder.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void set_occlusion_culling(bool enabled);
+    bool is_occlusion_culling() const;
+
+    //-----------------------------------------------------------------------------
+    //  Name : get_occlusion_stats ()
+    /// <summary>
+    /// Occlusion culling results of the last frame by camera entity, the six
+    /// faces of a reflection probe are summed under the probe entity.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    const std::unordered_map<entity, occlusion_stats>& get_occlusion_stats() const;
+
     //-----------------------------------------------------------------------------
     //  Name : frame_render (virtual )
     /// <summary>
@@ -70,6 +160,14 @@ public:
     //-----------------------------------------------------------------------------
     void receive(entity e);
 
+    //-----------------------------------------------------------------------------
+    //  Name : receive_many ()
+    /// <summary>
+    /// Batched counterpart of receive for entities destroyed together.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void receive_many(hpp::span<const entity> entities);
+
     //-----------------------------------------------------------------------------
     //  Name : build_reflections ()
     /// <summary>
@@ -78,7 +176,10 @@ public:
     ///
     /// </summary>
     //-----------------------------------------------------------------------------
-    void build_reflections_pass(entity_component_system& ecs, delta_t dt);
+    void build_reflections_pass(entity_component_system& ecs,
+                                const std::vector<probe_faces>& probes,
+                                std::vector<view_visibility>& views,
+                                delta_t dt);
 
     //-----------------------------------------------------------------------------
     //  Name : build_shadows ()
@@ -98,7 +199,10 @@ public:
     ///
     /// </summary>
     //-----------------------------------------------------------------------------
-    void camera_pass(entity_component_system& ecs, delta_t dt);
+    void camera_pass(entity_component_system& ecs,
+                     const std::vector<camera_view>& cameras,
+                     std::vector<view_visibility>& views,
+                     delta_t dt);
 
     //-----------------------------------------------------------------------------
     //  Name : scene_pass ()
@@ -111,6 +215,7 @@ public:
     std::shared_ptr<gfx::frame_buffer> deferred_render_full(camera& camera,
                                                             gfx::render_view& render_view,
                                                             entity_component_system& ecs,
+                                                            visibility_set_models_t& visibility_set,
                                                             std::unordered_map<entity, lod_data>& camera_lods,
                                                             delta_t dt);
 
@@ -184,7 +289,47 @@ public:
                                                         gfx::render_view& render_view);
 
 private:
+    //-----------------------------------------------------------------------------
+    //  Name : collect_visible ()
+    /// <summary>
+    /// Read only part of gather_visible_models, safe to call from several
+    /// threads once the bounds are up to date and the camera frustum is
+    /// computed. Returns indices in the bounds_system arrays.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    static std::vector<std::size_t> collect_visible(const bounds_system& bounds,
+                                                    const camera* camera,
+                                                    ecs::change_tick_t dirty_since,
+                                                    bool static_only,
+                                                    bool require_reflection_caster);
+
+    //-----------------------------------------------------------------------------
+    //  Name : cull_occluded ()
+    /// <summary>
+    /// Rasterizes the largest occluders among 'visible' into 'occlusion' and
+    /// removes the entries it hides. Thread safe like collect_visible.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    static occlusion_stats cull_occluded(const bounds_system& bounds,
+                                         const camera& camera,
+                                         std::vector<std::size_t>& visible,
+                                         math::occlusion_buffer& occlusion);
+
+    static visibility_set_models_t to_visibility_set(const bounds_system& bounds,
+                                                     const std::vector<std::size_t>& visible);
+
+    std::vector<probe_faces> prepare_reflections(entity_component_system& ecs, std::vector<view_visibility>& views);
+    std::vector<camera_view> prepare_cameras(entity_component_system& ecs, std::vector<view_visibility>& views);
+
     std::unordered_map<entity, std::unordered_map<entity, lod_data>> lod_data_;
+    /// Change tick at which the reflection probes were last rebuilt.
+    ecs::change_tick_t reflections_tick_ = 0;
+    /// Change tick at which the shadows were last rebuilt.
+    ecs::change_tick_t shadows_tick_ = 0;
+    /// One per view, reused from frame to frame.
+    std::vector<math::occlusion_buffer> occlusion_buffers_;
+    std::unordered_map<entity, occlusion_stats> occlusion_stats_;
+    bool occlusion_culling_ = true;
     /// Program that is responsible for rendering.
     std::unique_ptr<gpu_program> directional_light_program_;
     /// Program that is responsible for rendering.
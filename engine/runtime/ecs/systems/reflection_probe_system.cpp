@@ -19,11 +19,13 @@ void reflection_probe_system::frame_update(delta_t dt)
 
 reflection_probe_system::reflection_probe_system()
 {
-    on_frame_update.connect(this, &reflection_probe_system::frame_update);
+    const auto access = system_access().write<reflection_probe_component>().on_owner_thread();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("reflection_probe_system", this, &reflection_probe_system::frame_update, access);
 }
 
 reflection_probe_system::~reflection_probe_system()
 {
-    on_frame_update.disconnect(this, &reflection_probe_system::frame_update);
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
 }
 } // namespace runtime
@@ -1,44 +1,157 @@
 #include "scene_graph.h"
-#include "../../system/events.h"
 #include "../components/transform_component.h"
 
 #include <core/system/subsystem.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace runtime
 {
+namespace
+{
+const std::uint32_t INVALID_POSITION = std::numeric_limits<std::uint32_t>::max();
 
-void scene_graph::frame_update(delta_t dt)
+bool is_transform(const chandle<component>& comp)
 {
-    auto& ecs = core::get_subsystem<runtime::entity_component_system>();
-    roots_.clear();
-    auto all_entities = ecs.all_entities();
-    for(const auto entity : all_entities)
+    return std::dynamic_pointer_cast<transform_component>(comp.lock()) != nullptr;
+}
+} // namespace
+
+const std::vector<entity>& scene_graph::get_roots() const
+{
+    if(holes_ > 0)
     {
-        auto transform_comp = entity.get_component<transform_component>().lock();
-        if(transform_comp)
-        {
-            auto parent = transform_comp->get_parent();
-            if(parent.valid() == false)
-            {
-                roots_.push_back(entity);
-            }
-        }
-        else
+        roots_.erase(std::remove_if(std::begin(roots_), std::end(roots_),
+                                    [](const entity& e) { return !e.valid(); }),
+                     std::end(roots_));
+        for(std::size_t i = 0; i < roots_.size(); ++i)
         {
-            roots_.push_back(entity);
+            positions_[roots_[i].id().index()] = static_cast<std::uint32_t>(i);
         }
+        holes_ = 0;
+    }
+
+    return roots_;
+}
+
+void scene_graph::add_root(const entity& e)
+{
+    const auto index = e.id().index();
+    if(positions_.size() <= index)
+    {
+        positions_.resize(index + 1, INVALID_POSITION);
+    }
+    else if(positions_[index] != INVALID_POSITION)
+    {
+        return;
+    }
+
+    positions_[index] = static_cast<std::uint32_t>(roots_.size());
+    roots_.push_back(e);
+}
+
+void scene_graph::remove_root(const entity& e)
+{
+    const auto index = e.id().index();
+    if(index >= positions_.size() || positions_[index] == INVALID_POSITION)
+    {
+        return;
+    }
+
+    roots_[positions_[index]] = entity();
+    positions_[index] = INVALID_POSITION;
+    ++holes_;
+}
+
+void scene_graph::refresh_root(entity e)
+{
+    if(!e.valid())
+    {
+        return;
+    }
+
+    auto transform_comp = e.get_component<transform_component>().lock();
+    if(transform_comp && transform_comp->get_parent().valid())
+    {
+        remove_root(e);
+    }
+    else
+    {
+        add_root(e);
+    }
+}
+
+void scene_graph::on_created(entity e)
+{
+    add_root(e);
+}
+
+void scene_graph::on_destroyed(entity e)
+{
+    remove_root(e);
+}
+
+void scene_graph::on_many_created(hpp::span<const entity> entities)
+{
+    roots_.reserve(roots_.size() + entities.size());
+    for(const auto& e : entities)
+    {
+        add_root(e);
+    }
+}
+
+void scene_graph::on_many_destroyed(hpp::span<const entity> entities)
+{
+    for(const auto& e : entities)
+    {
+        remove_root(e);
+    }
+}
+
+void scene_graph::on_component_added(entity e, chandle<component> comp)
+{
+    if(is_transform(comp))
+    {
+        refresh_root(e);
+    }
+}
+
+void scene_graph::on_component_removed(entity e, chandle<component> comp)
+{
+    if(is_transform(comp))
+    {
+        add_root(e);
     }
 }
 
 scene_graph::scene_graph()
 {
-    runtime::on_frame_update.connect(this, &scene_graph::frame_update);
+    on_entity_created.connect(this, &scene_graph::on_created);
+    on_entity_destroyed.connect(this, &scene_graph::on_destroyed);
+    on_entities_created.connect(this, &scene_graph::on_many_created);
+    on_entities_destroyed.connect(this, &scene_graph::on_many_destroyed);
+    runtime::on_component_added.connect(this, &scene_graph::on_component_added);
+    runtime::on_component_removed.connect(this, &scene_graph::on_component_removed);
+    on_transform_parent_changed.connect(this, &scene_graph::refresh_root);
 
     transform_component::static_id();
+
+    auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+    for(const auto e : ecs.all_entities())
+    {
+        refresh_root(e);
+    }
 }
 
 scene_graph::~scene_graph()
 {
-    runtime::on_frame_update.disconnect(this, &scene_graph::frame_update);
+    on_entity_created.disconnect(this, &scene_graph::on_created);
+    on_entity_destroyed.disconnect(this, &scene_graph::on_destroyed);
+    on_entities_created.disconnect(this, &scene_graph::on_many_created);
+    on_entities_destroyed.disconnect(this, &scene_graph::on_many_destroyed);
+    runtime::on_component_added.disconnect(this, &scene_graph::on_component_added);
+    runtime::on_component_removed.disconnect(this, &scene_graph::on_component_removed);
+    on_transform_parent_changed.disconnect(this, &scene_graph::refresh_root);
 }
 } // namespace runtime
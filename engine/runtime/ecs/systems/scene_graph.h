@@ -13,31 +13,37 @@ class scene_graph
 public:
     scene_graph();
     ~scene_graph();
-    //-----------------------------------------------------------------------------
-    //  Name : frame_update (virtual )
-    /// <summary>
-    ///
-    ///
-    ///
-    /// </summary>
-    //-----------------------------------------------------------------------------
-    void frame_update(delta_t dt);
 
     //-----------------------------------------------------------------------------
     //  Name : getRoots ()
     /// <summary>
-    ///
-    ///
-    ///
+    /// Entities without a transform parent, in the order they became roots.
+    /// The list is maintained from the entity, component and parenting
+    /// events, so it costs nothing on frames without structural changes.
+    /// It may change while traversing the scene, take a copy if the traversal
+    /// can create or reparent entities.
     /// </summary>
     //-----------------------------------------------------------------------------
-    const std::vector<entity>& get_roots() const
-    {
-        return roots_;
-    }
+    const std::vector<entity>& get_roots() const;
 
 private:
-    /// scene roots
-    std::vector<entity> roots_;
+    void add_root(const entity& e);
+    void remove_root(const entity& e);
+    void refresh_root(entity e);
+
+    void on_created(entity e);
+    void on_destroyed(entity e);
+    void on_many_created(hpp::span<const entity> entities);
+    void on_many_destroyed(hpp::span<const entity> entities);
+    void on_component_added(entity e, chandle<component> comp);
+    void on_component_removed(entity e, chandle<component> comp);
+
+    /// scene roots. Removed roots leave an invalid entity behind until the
+    /// next get_roots call so the order of the rest is kept.
+    mutable std::vector<entity> roots_;
+    /// position of each entity index inside roots_
+    mutable std::vector<std::uint32_t> positions_;
+    /// number of removed entries still in roots_
+    mutable std::size_t holes_ = 0;
 };
 } // namespace runtime
@@ -0,0 +1,192 @@
+#include "system_scheduler.h"
+#include "../../system/events.h"
+
+#include <core/profiler/profiler.h>
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace runtime
+{
+bool system_access::conflicts_with(const system_access& other) const
+{
+    if(is_exclusive || other.is_exclusive)
+    {
+        return true;
+    }
+
+    return (writes & (other.reads | other.writes)).any() || (other.writes & reads).any();
+}
+
+system_scheduler::system_id system_scheduler::add_system(const std::string& name,
+                                                         std::function<void(delta_t)> update,
+                                                         const system_access& access)
+{
+    system_entry entry;
+    entry.id = next_id_++;
+    entry.update = std::move(update);
+    entry.access = access;
+    entry.profile_name = core::profiler::intern(name);
+    systems_.emplace_back(std::move(entry));
+
+    system_timing timing;
+    timing.name = name;
+    timings_.emplace_back(std::move(timing));
+
+    stages_dirty_ = true;
+    return systems_.back().id;
+}
+
+void system_scheduler::remove_system(system_id id)
+{
+    auto it = std::find_if(std::begin(systems_),
+                           std::end(systems_),
+                           [id](const auto& entry) { return entry.id == id; });
+    if(it == std::end(systems_))
+    {
+        return;
+    }
+
+    timings_.erase(std::begin(timings_) + std::distance(std::begin(systems_), it));
+    systems_.erase(it);
+    stages_dirty_ = true;
+}
+
+void system_scheduler::set_serial(bool serial)
+{
+    serial_ = serial;
+}
+
+bool system_scheduler::is_serial() const
+{
+    return serial_;
+}
+
+const std::vector<system_scheduler::system_timing>& system_scheduler::get_timings() const
+{
+    return timings_;
+}
+
+void system_scheduler::build_stages()
+{
+    stages_.clear();
+
+    // A system runs one stage after the latest earlier system it conflicts with.
+    std::vector<std::size_t> stage_of(systems_.size(), 0);
+    for(std::size_t i = 0; i < systems_.size(); ++i)
+    {
+        for(std::size_t j = 0; j < i; ++j)
+        {
+            if(systems_[i].access.conflicts_with(systems_[j].access))
+            {
+                stage_of[i] = std::max(stage_of[i], stage_of[j] + 1);
+            }
+        }
+
+        if(stages_.size() <= stage_of[i])
+        {
+            stages_.resize(stage_of[i] + 1);
+        }
+        stages_[stage_of[i]].push_back(i);
+        timings_[i].stage = stage_of[i];
+    }
+
+    stages_dirty_ = false;
+}
+
+void system_scheduler::run_system(std::size_t index, delta_t dt)
+{
+    core::profiler::scoped_zone zone(systems_[index].profile_name);
+    const auto start = std::chrono::steady_clock::now();
+    systems_[index].update(dt);
+    timings_[index].time = std::chrono::steady_clock::now() - start;
+}
+
+void system_scheduler::run(delta_t dt)
+{
+    PROFILE_SCOPE("system_scheduler::run");
+
+    if(stages_dirty_)
+    {
+        build_stages();
+    }
+
+    if(serial_)
+    {
+        for(std::size_t i = 0; i < systems_.size(); ++i)
+        {
+            run_system(i, dt);
+        }
+        return;
+    }
+
+    auto& tasks = core::get_subsystem<core::task_system>();
+    std::vector<core::task_future<void>> jobs;
+    for(const auto& stage : stages_)
+    {
+        jobs.clear();
+        for(auto index : stage)
+        {
+            if(!systems_[index].access.owner_thread)
+            {
+                jobs.emplace_back(tasks.push_on_pool(core::task_pool::compute, core::task_priority::frame_critical,
+                                                     [this, index, dt]() { run_system(index, dt); }));
+            }
+        }
+
+        // The owner thread works on its own systems while the workers run
+        // the others. The whole stage finishes before anything is rethrown.
+        std::exception_ptr error;
+        for(auto index : stage)
+        {
+            if(systems_[index].access.owner_thread)
+            {
+                try
+                {
+                    run_system(index, dt);
+                }
+                catch(...)
+                {
+                    error = error ? error : std::current_exception();
+                }
+            }
+        }
+
+        // Helps with worker tasks instead of sleeping until the jobs are done.
+        tasks.wait_all(jobs);
+        for(const auto& job : jobs)
+        {
+            try
+            {
+                job.get();
+            }
+            catch(...)
+            {
+                error = error ? error : std::current_exception();
+            }
+        }
+
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void system_scheduler::frame_update(delta_t dt)
+{
+    run(dt);
+}
+
+system_scheduler::system_scheduler()
+{
+    on_frame_update.connect(this, &system_scheduler::frame_update);
+}
+
+system_scheduler::~system_scheduler()
+{
+    on_frame_update.disconnect(this, &system_scheduler::frame_update);
+}
+} // namespace runtime
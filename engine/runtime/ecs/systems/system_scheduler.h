@@ -0,0 +1,166 @@
+#pragma once
+
+#include "../ecs.h"
+
+#include <core/common/basetypes.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace runtime
+{
+//-----------------------------------------------------------------------------
+//  Name : system_access (Struct)
+/// <summary>
+/// The component types a system reads and writes during its update. Two
+/// systems conflict when one of them writes a type the other one reads or
+/// writes.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct system_access
+{
+    template<typename... Components>
+    system_access& read()
+    {
+        set(reads, {rtti::type_index_sequential_t::id<component, Components>()...});
+        return *this;
+    }
+
+    template<typename... Components>
+    system_access& write()
+    {
+        set(writes, {rtti::type_index_sequential_t::id<component, Components>()...});
+        return *this;
+    }
+
+    /// The system touches state that is not described by components and
+    /// conflicts with every other system.
+    system_access& exclusive()
+    {
+        is_exclusive = true;
+        return *this;
+    }
+
+    /// The system calls APIs that are only usable from the owner thread, it
+    /// may still run while other systems run on the workers.
+    system_access& on_owner_thread()
+    {
+        owner_thread = true;
+        return *this;
+    }
+
+    bool conflicts_with(const system_access& other) const;
+
+    entity_component_system::component_mask_t reads;
+    entity_component_system::component_mask_t writes;
+    bool is_exclusive = false;
+    bool owner_thread = false;
+
+private:
+    static void set(entity_component_system::component_mask_t& mask,
+                    std::initializer_list<rtti::type_index_sequential_t::index_t> ids)
+    {
+        for(auto id : ids)
+        {
+            mask.set(id);
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+//  Name : system_scheduler (Class)
+/// <summary>
+/// Runs the systems on each on_frame_update. Systems are registered with
+/// the component types they access. A system depends on every system
+/// registered before it that it conflicts with. The dependencies split the
+/// systems into stages. The systems of a stage run concurrently on the task
+/// system and the stages run one after another, so the results are the same
+/// as running everything in registration order.
+/// </summary>
+//-----------------------------------------------------------------------------
+class system_scheduler
+{
+public:
+    using system_id = std::uint32_t;
+    using duration_t = std::chrono::steady_clock::duration;
+
+    struct system_timing
+    {
+        std::string name;
+        /// time spent in the last update
+        duration_t time = duration_t::zero();
+        /// stage the system runs in, systems of a stage run concurrently
+        std::size_t stage = 0;
+    };
+
+    system_scheduler();
+    ~system_scheduler();
+
+    //-----------------------------------------------------------------------------
+    //  Name : add_system ()
+    /// <summary>
+    /// Registers 'update' to run every frame after the conflicting systems
+    /// registered before it. Returns a handle for remove_system.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    system_id add_system(const std::string& name, std::function<void(delta_t)> update, const system_access& access);
+
+    template<typename T>
+    system_id add_system(const std::string& name, T* object, void (T::*update)(delta_t), const system_access& access)
+    {
+        return add_system(name, [object, update](delta_t dt) { (object->*update)(dt); }, access);
+    }
+
+    void remove_system(system_id id);
+
+    //-----------------------------------------------------------------------------
+    //  Name : set_serial ()
+    /// <summary>
+    /// Runs every system on the owner thread in registration order. Meant for
+    /// debugging ordering and data races.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void set_serial(bool serial);
+    bool is_serial() const;
+
+    //-----------------------------------------------------------------------------
+    //  Name : run ()
+    /// <summary>
+    /// Runs every system once. Exceptions thrown by a system are rethrown
+    /// once its stage is done.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void run(delta_t dt);
+
+    /// in registration order
+    const std::vector<system_timing>& get_timings() const;
+
+private:
+    struct system_entry
+    {
+        system_id id = 0;
+        std::function<void(delta_t)> update;
+        system_access access;
+        /// interned, profiler records outlive the system
+        const char* profile_name = nullptr;
+    };
+
+    void frame_update(delta_t dt);
+    void build_stages();
+    void run_system(std::size_t index, delta_t dt);
+
+    /// in registration order
+    std::vector<system_entry> systems_;
+    /// same indexing as systems_
+    std::vector<system_timing> timings_;
+    /// indices in systems_ by stage
+    std::vector<std::vector<std::size_t>> stages_;
+    system_id next_id_ = 0;
+    bool stages_dirty_ = true;
+    bool serial_ = false;
+};
+} // namespace runtime
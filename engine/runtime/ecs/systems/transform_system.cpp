@@ -0,0 +1,223 @@
+#include "transform_system.h"
+#include "../../system/events.h"
+#include "../components/transform_component.h"
+
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+namespace runtime
+{
+namespace
+{
+/// Levels smaller than this are resolved on the calling thread.
+const std::size_t PARALLEL_GRAIN_SIZE = 1024;
+
+bool is_transform(const chandle<component>& comp)
+{
+    return std::dynamic_pointer_cast<transform_component>(comp.lock()) != nullptr;
+}
+} // namespace
+
+template<typename F>
+void transform_system::for_ranges(std::size_t begin, std::size_t end, const F& f)
+{
+    if(end - begin < 2 * PARALLEL_GRAIN_SIZE)
+    {
+        f(begin, end);
+        return;
+    }
+
+    auto& tasks = core::get_subsystem<core::task_system>();
+    tasks.parallel_for(begin, end, PARALLEL_GRAIN_SIZE, f, core::task_priority::frame_critical);
+}
+
+void transform_system::propagate()
+{
+    auto& ecs = core::get_subsystem<entity_component_system>();
+    const auto since = last_tick_;
+    last_tick_ = ecs::get_change_tick();
+    if(!hierarchy_dirty_ && !ecs.changed_since<transform_component>(since))
+    {
+        return;
+    }
+
+    const bool force = hierarchy_dirty_;
+    if(hierarchy_dirty_)
+    {
+        rebuild(ecs);
+        hierarchy_dirty_ = false;
+    }
+
+    for_ranges(0, nodes_.size(),
+               [this, force](std::size_t first, std::size_t last) { gather_range(first, last, force); });
+
+    // The nodes of a level only read their parents from the levels before
+    // it, so the subtrees of a level can be resolved in parallel.
+    for(std::size_t level = 0; level + 1 < levels_.size(); ++level)
+    {
+        for_ranges(levels_[level], levels_[level + 1],
+                   [this](std::size_t first, std::size_t last) { resolve_range(first, last); });
+    }
+
+    for_ranges(0, nodes_.size(), [this](std::size_t first, std::size_t last) { write_back_range(first, last); });
+}
+
+void transform_system::gather_range(std::size_t begin, std::size_t end, bool force)
+{
+    for(std::size_t i = begin; i < end; ++i)
+    {
+        const auto node = nodes_[i];
+        const bool dirty = force || node->dirty_;
+        dirty_[i] = dirty;
+        if(dirty)
+        {
+            locals_[i] = math::affine3x4(node->local_transform_);
+        }
+        else if(has_children_[i])
+        {
+            // May have been resolved lazily since the last sweep.
+            worlds_[i] = math::affine3x4(node->world_transform_);
+        }
+    }
+}
+
+void transform_system::resolve_range(std::size_t begin, std::size_t end)
+{
+    for(std::size_t i = begin; i < end; ++i)
+    {
+        if(!dirty_[i])
+        {
+            continue;
+        }
+
+        const auto parent = parents_[i];
+        worlds_[i] = parent >= 0 ? worlds_[std::size_t(parent)] * locals_[i] : locals_[i];
+    }
+}
+
+void transform_system::write_back_range(std::size_t begin, std::size_t end)
+{
+    for(std::size_t i = begin; i < end; ++i)
+    {
+        if(!dirty_[i])
+        {
+            continue;
+        }
+
+        auto node = nodes_[i];
+        node->world_transform_ = worlds_[i].to_transform();
+        node->dirty_ = false;
+    }
+}
+
+void transform_system::rebuild(entity_component_system& ecs)
+{
+    nodes_.clear();
+    parents_.clear();
+    levels_.clear();
+
+    ecs.for_each<transform_component>(
+        [this](entity e, transform_component& transform)
+        {
+            const auto& parent = transform.get_parent();
+            if(!parent.valid() || !parent.has_component<transform_component>())
+            {
+                nodes_.emplace_back(&transform);
+                parents_.emplace_back(-1);
+            }
+        });
+
+    std::size_t level_begin = 0;
+    while(level_begin < nodes_.size())
+    {
+        const auto level_end = nodes_.size();
+        levels_.emplace_back(level_begin);
+        for(auto i = level_begin; i < level_end; ++i)
+        {
+            const auto parent = nodes_[i]->get_entity();
+            for(const auto& child : nodes_[i]->get_children())
+            {
+                if(!child.valid())
+                {
+                    continue;
+                }
+
+                auto child_transform = child.get_component<transform_component>().lock();
+                if(child_transform && child_transform->get_parent() == parent)
+                {
+                    nodes_.emplace_back(child_transform.get());
+                    parents_.emplace_back(static_cast<std::int32_t>(i));
+                }
+            }
+        }
+        level_begin = level_end;
+    }
+    levels_.emplace_back(nodes_.size());
+
+    const auto count = nodes_.size();
+    has_children_.assign(count, 0);
+    for(auto parent : parents_)
+    {
+        if(parent >= 0)
+        {
+            has_children_[std::size_t(parent)] = 1;
+        }
+    }
+    dirty_.resize(count);
+    locals_.resize(count);
+    worlds_.resize(count);
+}
+
+void transform_system::frame_update(delta_t)
+{
+    propagate();
+}
+
+void transform_system::frame_render(delta_t)
+{
+    propagate();
+}
+
+void transform_system::on_parent_changed(entity)
+{
+    hierarchy_dirty_ = true;
+}
+
+void transform_system::on_component_added(entity, chandle<component> comp)
+{
+    if(is_transform(comp))
+    {
+        hierarchy_dirty_ = true;
+    }
+}
+
+void transform_system::on_component_removed(entity, chandle<component> comp)
+{
+    if(is_transform(comp))
+    {
+        hierarchy_dirty_ = true;
+    }
+}
+
+transform_system::transform_system()
+{
+    // Registered before the systems reading world transforms, the scheduler
+    // runs them once the transforms are resolved.
+    const auto access = system_access().write<transform_component>();
+    auto& scheduler = core::get_subsystem<system_scheduler>();
+    update_id_ = scheduler.add_system("transform_system", this, &transform_system::frame_update, access);
+    on_frame_render.connect(this, &transform_system::frame_render);
+    on_transform_parent_changed.connect(this, &transform_system::on_parent_changed);
+    runtime::on_component_added.connect(this, &transform_system::on_component_added);
+    runtime::on_component_removed.connect(this, &transform_system::on_component_removed);
+}
+
+transform_system::~transform_system()
+{
+    core::get_subsystem<system_scheduler>().remove_system(update_id_);
+    on_frame_render.disconnect(this, &transform_system::frame_render);
+    on_transform_parent_changed.disconnect(this, &transform_system::on_parent_changed);
+    runtime::on_component_added.disconnect(this, &transform_system::on_component_added);
+    runtime::on_component_removed.disconnect(this, &transform_system::on_component_removed);
+}
+} // namespace runtime
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../ecs.h"
+#include "system_scheduler.h"
+
+#include <core/common/basetypes.hpp>
+#include <core/math/math_includes.h>
+
+#include <cstdint>
+#include <vector>
+
+class transform_component;
+
+namespace runtime
+{
+class transform_system
+{
+public:
+    transform_system();
+    ~transform_system();
+
+    //-----------------------------------------------------------------------------
+    //  Name : propagate ()
+    /// <summary>
+    /// Resolves every dirty world transform in a single breadth first sweep
+    /// over the hierarchy. The dirty local transforms are gathered into
+    /// arrays owned by the system, composed there level by level and the
+    /// results copied back to the components once. Does nothing if no
+    /// transform changed since the last sweep.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void propagate();
+
+private:
+    void frame_update(delta_t dt);
+    void frame_render(delta_t dt);
+
+    //-----------------------------------------------------------------------------
+    //  Name : rebuild ()
+    /// <summary>
+    /// Rebuilds the depth sorted node arrays. Only called when a transform
+    /// was added, removed or reparented.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    void rebuild(entity_component_system& ecs);
+
+    void gather_range(std::size_t begin, std::size_t end, bool force);
+    void resolve_range(std::size_t begin, std::size_t end);
+    void write_back_range(std::size_t begin, std::size_t end);
+
+    //-----------------------------------------------------------------------------
+    //  Name : for_ranges ()
+    /// <summary>
+    /// Calls f(first, last) over [begin, end), split across the workers when
+    /// the range is large enough.
+    /// </summary>
+    //-----------------------------------------------------------------------------
+    template<typename F>
+    void for_ranges(std::size_t begin, std::size_t end, const F& f);
+
+    void on_parent_changed(entity e);
+    void on_component_added(entity e, chandle<component> comp);
+    void on_component_removed(entity e, chandle<component> comp);
+
+    /// transforms sorted by depth, parents always come before their children
+    std::vector<transform_component*> nodes_;
+    /// index of the parent of each node inside nodes_, or -1 for roots
+    std::vector<std::int32_t> parents_;
+    /// whether the node has children, same indexing as nodes_
+    std::vector<std::uint8_t> has_children_;
+    /// whether the node is resolved in the current sweep
+    std::vector<std::uint8_t> dirty_;
+    /// local transforms of the dirty nodes
+    std::vector<math::affine3x4> locals_;
+    /// world transforms of the dirty nodes and of the parents
+    std::vector<math::affine3x4> worlds_;
+    /// offset of the first node of each depth level, plus the end offset
+    std::vector<std::size_t> levels_;
+    /// the node arrays need to be rebuilt
+    bool hierarchy_dirty_ = true;
+    /// change tick of the last sweep
+    ecs::change_tick_t last_tick_ = 0;
+    /// registration of frame_update in the system_scheduler
+    system_scheduler::system_id update_id_ = 0;
+};
+} // namespace runtime
@@ -18,6 +18,10 @@ REFLECT(model_component)
 				  &model_component::set_casts_shadow)(rttr::metadata("pretty_name", "Casts Shadow"))
 		.property("casts_reflection", &model_component::casts_reflection,
 				  &model_component::set_casts_reflection)(rttr::metadata("pretty_name", "Casts Reflection"))
+		.property("occluder", &model_component::is_occluder,
+				  &model_component::set_occluder)(rttr::metadata("pretty_name", "Occluder"),
+												  rttr::metadata("tooltip", "Hides the models behind it on the CPU, "
+																			"use for large and simple meshes."))
 		.property("model", &model_component::get_model,
 				  &model_component::set_model)(rttr::metadata("pretty_name", "Model"));
 }
@@ -28,6 +32,7 @@ SAVE(model_component)
 	try_save(ar, cereal::make_nvp("static", obj.static_));
 	try_save(ar, cereal::make_nvp("casts_shadow", obj.casts_shadow_));
 	try_save(ar, cereal::make_nvp("casts_reflection", obj.casts_reflection_));
+	try_save(ar, cereal::make_nvp("occluder", obj.occluder_));
 	try_save(ar, cereal::make_nvp("model", obj.model_));
 	try_save(ar, cereal::make_nvp("bone_entities", obj.bone_entities_));
 }
@@ -40,6 +45,7 @@ LOAD(model_component)
 	try_load(ar, cereal::make_nvp("static", obj.static_));
 	try_load(ar, cereal::make_nvp("casts_shadow", obj.casts_shadow_));
 	try_load(ar, cereal::make_nvp("casts_reflection", obj.casts_reflection_));
+	try_load(ar, cereal::make_nvp("occluder", obj.occluder_));
 	try_load(ar, cereal::make_nvp("model", obj.model_));
 	try_load(ar, cereal::make_nvp("bone_entities", obj.bone_entities_));
 }
@@ -45,6 +45,7 @@ LOAD(transform_component)
 			if(child_transform)
 			{
 				child_transform->parent_ = obj.get_entity();
+				runtime::on_transform_parent_changed(child);
 			}
 		}
 	}
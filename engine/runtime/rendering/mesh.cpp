@@ -3008,19 +3008,21 @@ bone_palette::~bone_palette()
 {
 }
 
-std::vector<math::transform>
+std::vector<math::transform::mat4_t>
 bone_palette::get_skinning_matrices(const std::vector<math::transform>& node_transforms,
 									const skin_bind_data& bind_data, bool compute_inverse_transpose) const
 {
+	using mat4_t = math::transform::mat4_t;
+
 	// Retrieve the main list of bones from the skin bind data that will
 	// be referenced by the palette's bone index list.
 	const auto& bind_list = bind_data.get_bones();
 	if(node_transforms.empty())
-		return node_transforms;
+		return {};
 
 	const std::uint32_t max_blend_transforms = gfx::get_max_blend_transforms();
-	std::vector<math::transform> transforms;
-	transforms.resize(max_blend_transforms);
+	std::vector<mat4_t> transforms;
+	transforms.resize(max_blend_transforms, mat4_t(1.0f));
 
 	// Compute transformation matrix for each bone in the palette
 	for(size_t i = 0; i < bones_.size(); ++i)
@@ -3028,11 +3030,14 @@ bone_palette::get_skinning_matrices(const std::vector<math::transform>& node_tra
 		auto bone = bones_[i];
 		const auto& bone_transform = node_transforms[bone];
 		const auto& bone_data = bind_list[bone];
-		auto& transform = transforms[i];
-		transform = bone_transform * bone_data.bind_pose_transform;
+		const auto skinning = math::affine3x4(bone_transform) * math::affine3x4(bone_data.bind_pose_transform);
 		if(compute_inverse_transpose)
 		{
-			transform = math::transpose(math::inverse(transform));
+			transforms[i] = math::transpose(math::inverse(skinning).to_matrix());
+		}
+		else
+		{
+			transforms[i] = skinning.to_matrix();
 		}
 
 	} // Next Bone
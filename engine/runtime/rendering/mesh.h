@@ -225,9 +225,9 @@ public:
 	/// drawing the skinned mesh.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	std::vector<math::transform> get_skinning_matrices(const std::vector<math::transform>& node_transforms,
-													   const skin_bind_data& bind_data,
-													   bool compute_inverse_transpose) const;
+	std::vector<math::transform::mat4_t>
+	get_skinning_matrices(const std::vector<math::transform>& node_transforms, const skin_bind_data& bind_data,
+						  bool compute_inverse_transpose) const;
 
 	//-----------------------------------------------------------------------------
 	//  Name : compute_palette_fit()
@@ -142,7 +142,7 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 	}
 
 	auto render_subset = [this, &mesh](gfx::view_id id, bool skinned, std::uint32_t group_id,
-									   const std::vector<math::transform>& matrices, bool apply_cull,
+									   const std::vector<math::transform::mat4_t>& matrices, bool apply_cull,
 									   bool depth_write, bool depth_test, std::uint64_t extra_states,
 									   gpu_program* user_program,
 									   std::function<void(gpu_program&)> setup_params) {
@@ -183,14 +183,7 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 
 			if(!matrices.empty())
 			{
-				using mat_type = math::transform::mat4_t;
-				std::vector<mat_type> mats;
-				mats.reserve(matrices.size());
-				for(const auto& m : matrices)
-				{
-					mats.emplace_back(m.get_matrix());
-				}
-				gfx::set_transform(mats.data(), static_cast<std::uint16_t>(mats.size()));
+				gfx::set_transform(matrices.data(), static_cast<std::uint16_t>(matrices.size()));
 			}
 
 			gfx::set_state(extra_states);
@@ -230,7 +223,7 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 	{
 		for(std::size_t i = 0; i < mesh->get_subset_count(); ++i)
 		{
-			render_subset(id, false, std::uint32_t(i), {world_transform}, apply_cull, depth_write, depth_test,
+			render_subset(id, false, std::uint32_t(i), {world_transform.get_matrix()}, apply_cull, depth_write, depth_test,
 						  extra_states, user_program, setup_params);
 		}
 	}
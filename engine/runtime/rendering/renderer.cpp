@@ -17,7 +17,8 @@ renderer::renderer(cmd_line::parser& parser)
 	on_platform_events.connect(this, &renderer::platform_events);
 	on_frame_end.connect(this, &renderer::frame_end);
 
-	if(!init_backend(parser))
+	parser.try_get("headless", headless_);
+	if(!init_backend(parser) || headless_)
 	{
 		return;
 	}
@@ -133,6 +134,23 @@ void renderer::platform_events(const std::pair<std::uint32_t, bool>& info,
 
 bool renderer::init_backend(cmd_line::parser& parser)
 {
+	if(headless_)
+	{
+		gfx::init_type init_data;
+		init_data.type = gfx::renderer_type::Noop;
+		init_data.resolution.width = 1280;
+		init_data.resolution.height = 720;
+		init_data.resolution.reset = BGFX_RESET_NONE;
+		if(!gfx::init(init_data))
+		{
+			APPLOG_ERROR("Could not initialize headless rendering backend!");
+			return false;
+		}
+
+		APPLOG_INFO("Running headless, using {0} rendering backend.",
+					gfx::get_renderer_name(gfx::get_renderer_type()));
+		return true;
+	}
 
 	mml::video_mode desktop = mml::video_mode::get_desktop_mode();
 	desktop.width = 100;
@@ -24,6 +24,19 @@ struct renderer
 	//-----------------------------------------------------------------------------
 	bool init_backend(cmd_line::parser& parser);
 
+	//-----------------------------------------------------------------------------
+	//  Name : is_headless ()
+	/// <summary>
+	/// True when started with --headless. The backend is then bgfx's Noop
+	/// renderer, which accepts every call and draws nothing, and no window is
+	/// ever created.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline bool is_headless() const
+	{
+		return headless_;
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : frame_end ()
 	/// <summary>
@@ -86,6 +99,7 @@ struct renderer
 
 protected:
 	std::uint32_t render_frame_ = 0;
+	bool headless_ = false;
 
 	/// engine windows
 	std::unique_ptr<mml::window> init_window_;
@@ -6,16 +6,20 @@
 #include "../ecs/ecs.h"
 #include "../ecs/systems/audio_system.h"
 #include "../ecs/systems/bone_system.h"
+#include "../ecs/systems/bounds_system.h"
 #include "../ecs/systems/camera_system.h"
 #include "../ecs/systems/deferred_rendering.h"
 #include "../ecs/systems/reflection_probe_system.h"
 #include "../ecs/systems/scene_graph.h"
+#include "../ecs/systems/system_scheduler.h"
+#include "../ecs/systems/transform_system.h"
 #include "../input/input.h"
 #include "../rendering/render_window.h"
 #include "../rendering/renderer.h"
 
 #include <core/audio/library.h>
 #include <core/logging/logging.h>
+#include <core/profiler/profiler.h>
 #include <core/serialization/serialization.h>
 #include <core/simulation/simulation.h>
 #include <core/tasks/task_system.h>
@@ -43,10 +47,11 @@ void app::setup(cmd_line::parser& parser)
 	audio::set_info_logger([](const std::string& msg) { APPLOG_INFO(msg); });
 	audio::set_error_logger([](const std::string& msg) { APPLOG_ERROR(msg); });
 
-	ecs::set_frame_getter([]() { return core::get_subsystem<core::simulation>().get_frame(); });
-
 	parser.set_optional<std::string>("r", "renderer", "auto", "Select preferred renderer.");
 	parser.set_optional<bool>("n", "novsync", false, "Disable vsync.");
+	parser.set_optional<bool>("hl", "headless", false, "Run without windows or a GPU.");
+	parser.set_optional<std::uint32_t>("f", "fps", 200, "Maximum frames per second, 0 for unlimited.");
+	parser.set_optional<std::uint32_t>("fc", "frames", 0, "Quit after this many frames, 0 to run until closed.");
 }
 
 void app::start(cmd_line::parser& parser)
@@ -60,12 +65,24 @@ void app::start(cmd_line::parser& parser)
 	core::add_subsystem<core::task_system>(false);
 	setup_asset_manager();
 	core::add_subsystem<entity_component_system>();
+	core::add_subsystem<system_scheduler>();
 	core::add_subsystem<scene_graph>();
+	core::add_subsystem<transform_system>();
+	core::add_subsystem<bounds_system>();
 	core::add_subsystem<bone_system>();
 	core::add_subsystem<camera_system>();
 	core::add_subsystem<reflection_probe_system>();
 	core::add_subsystem<deferred_rendering>();
 	core::add_subsystem<audio_system>();
+
+	auto& sim = core::get_subsystem<core::simulation>();
+	std::uint32_t fps = 0;
+	if(parser.try_get("fps", fps))
+	{
+		sim.set_max_fps(fps);
+	}
+	parser.try_get("frames", max_frames_);
+	headless_ = core::get_subsystem<renderer>().is_headless();
 }
 
 void app::stop()
@@ -113,42 +130,89 @@ void app::run_one_frame()
 {
 	using namespace std::literals;
 
+	core::profiler::mark_frame();
+	PROFILE_SCOPE("app::run_one_frame");
+
 	auto& sim = core::get_subsystem<core::simulation>();
 	auto& tasks = core::get_subsystem<core::task_system>();
 	auto& renderer = core::get_subsystem<runtime::renderer>();
-	const bool is_active = renderer.get_focused_window() != nullptr;
-	sim.run_one_frame(is_active);
-	tasks.run_on_owner_thread(5ms);
+	auto& ecs = core::get_subsystem<entity_component_system>();
+	// Headless runs have no window to lose focus, they always tick at full rate.
+	const bool is_active = headless_ || renderer.get_focused_window() != nullptr;
+	{
+		PROFILE_SCOPE("simulation");
+		sim.run_one_frame(is_active);
+	}
+	ecs::begin_frame();
+	{
+		PROFILE_SCOPE("owner tasks");
+		tasks.run_on_owner_thread(5ms);
+	}
+
+	// sync point for the structural changes recorded by other threads
+	ecs.playback_commands();
 
 	auto dt = sim.get_delta_time();
 
-	poll_events();
+	{
+		PROFILE_SCOPE("poll_events");
+		poll_events();
+	}
 
 	renderer.process_pending_windows();
 
 	const auto& windows = renderer.get_windows();
 	bool should_quit = std::all_of(std::begin(windows), std::end(windows),
 								   [](const auto& window) { return !window->is_visible(); });
-	if(should_quit)
+	if(should_quit && !headless_)
 	{
 		quit(0);
 		return;
 	}
 
-	on_frame_begin(dt);
+	{
+		PROFILE_SCOPE("on_frame_begin");
+		on_frame_begin(dt);
+	}
 
-	on_frame_update(dt);
+	// Runs after the frame begins, so the fixed steps see its input.
+	const auto fixed_dt = sim.get_fixed_delta_time();
+	for(std::uint32_t i = 0; i < sim.get_fixed_steps(); ++i)
+	{
+		PROFILE_SCOPE("on_frame_fixed_update");
+		on_frame_fixed_update(fixed_dt);
+	}
 
-	on_frame_render(dt);
+	{
+		PROFILE_SCOPE("on_frame_update");
+		on_frame_update(dt);
+	}
 
-	on_frame_ui_render(dt);
+	{
+		PROFILE_SCOPE("on_frame_render");
+		on_frame_render(dt);
+	}
+
+	{
+		PROFILE_SCOPE("on_frame_ui_render");
+		on_frame_ui_render(dt);
+	}
+
+	{
+		PROFILE_SCOPE("on_frame_end");
+		on_frame_end(dt);
+	}
 
-	on_frame_end(dt);
+	if(max_frames_ > 0 && sim.get_frame() >= max_frames_)
+	{
+		quit(0);
+	}
 }
 
 int app::run(int argc, char* argv[])
 {
 	core::details::initialize();
+	core::profiler::set_thread_name("main");
 
 	cmd_line::parser parser(argc, argv);
 
@@ -184,8 +248,21 @@ int app::run(int argc, char* argv[])
 	}
 
 	APPLOG_INFO("Starting...");
+	const auto loop_start = std::chrono::steady_clock::now();
+	std::uint64_t frames = 0;
 	while(running_)
+	{
 		run_one_frame();
+		++frames;
+	}
+
+	if(headless_ && frames > 0)
+	{
+		const auto loop_time = std::chrono::steady_clock::now() - loop_start;
+		const auto total_ms = std::chrono::duration<double, std::milli>(loop_time).count();
+		APPLOG_INFO("Ran {0} frames in {1:.3f} ms, {2:.3f} ms per frame.", frames, total_ms,
+					total_ms / double(frames));
+	}
 
 	APPLOG_INFO("Deinitializing...");
 
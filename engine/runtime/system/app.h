@@ -71,5 +71,9 @@ protected:
 	/// exit code of the application
 	int exitcode_ = 0;
 	bool running_ = true;
+	/// no windows, the renderer runs bgfx's Noop backend
+	bool headless_ = false;
+	/// quit after this many frames, 0 runs until closed
+	std::uint32_t max_frames_ = 0;
 };
 }
@@ -3,6 +3,7 @@
 namespace runtime
 {
 hpp::event<void(delta_t)> on_frame_begin;
+hpp::event<void(delta_t)> on_frame_fixed_update;
 hpp::event<void(delta_t)> on_frame_update;
 hpp::event<void(delta_t)> on_frame_render;
 hpp::event<void(delta_t)> on_frame_ui_render;
@@ -12,6 +12,9 @@ namespace runtime
 {
 /// engine loop events
 extern hpp::event<void(delta_t)> on_frame_begin;
+/// runs get_fixed_steps() times per frame with the fixed delta time, see
+/// core::simulation::set_fixed_timestep
+extern hpp::event<void(delta_t)> on_frame_fixed_update;
 extern hpp::event<void(delta_t)> on_frame_update;
 extern hpp::event<void(delta_t)> on_frame_render;
 extern hpp::event<void(delta_t)> on_frame_ui_render;